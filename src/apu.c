@@ -0,0 +1,772 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "./headers/apu.h"
+#include "./headers/blip.h"
+#include "./headers/expansion.h"
+#include "./headers/scheduler.h"
+
+#define AMPLITUDE 30000
+
+static const uint8_t lengths[32] = {
+    10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
+    12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
+};
+
+static const uint8_t duties[4][8] = {
+    {0, 1, 0, 0, 0, 0, 0, 0}, {0, 1, 1, 0, 0, 0, 0, 0}, {0, 1, 1, 1, 1, 0, 0, 0}, {1, 0, 0, 1, 1, 1, 1, 1}
+};
+
+/*
+    From each phase of each duty, how many steps the pulse takes before its
+    output changes. Phases count down.
+*/
+static const uint8_t runs[4][8] = {
+    {7, 1, 1, 2, 3, 4, 5, 6}, {6, 1, 2, 1, 2, 3, 4, 5}, {4, 1, 2, 3, 4, 1, 2, 3}, {6, 1, 2, 1, 2, 3, 4, 5}
+};
+
+static const uint8_t triangleSteps[32] = {
+    15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+static const uint16_t noisePeriods[16] = {
+    4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
+};
+
+static const uint16_t dmcPeriods[16] = {
+    428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54
+};
+
+/*
+    CPU cycles from the start of a frame counter sequence to each of its
+    steps, then to the start of the next sequence. The five step sequence's
+    fourth step does nothing, so it is left out.
+*/
+static const uint16_t frameSteps[2][5] = {
+    {7457, 14913, 22371, 29829, 29830}, {7457, 14913, 22371, 37281, 37282}
+};
+
+
+/* ---------
+    Channels
+    -------- */
+static uint8_t volume(const struct Envelope *envelope) {
+    return envelope->constant ? envelope->period : envelope->decay;
+}
+
+static uint16_t sweepTarget(const struct Pulse *pulse, int channel) {
+    uint16_t change = pulse->timer >> pulse->sweepShift;
+    if (!pulse->sweepNegate) {
+        return pulse->timer + change;
+    }
+    return pulse->timer - change - (channel == CHANNEL_PULSE1);
+}
+
+/*
+    A pulse is silenced by a period too short to hear, or one the sweep
+    would take past eleven bits, whether or not the sweep is enabled
+*/
+static int pulseMuted(const struct Pulse *pulse, int channel) {
+    return pulse->timer < 8 || (!pulse->sweepNegate && sweepTarget(pulse, channel) > 0x7FF);
+}
+
+static uint8_t output(const struct APU *apu, int channel) {
+    switch (channel) {
+        case CHANNEL_PULSE1:
+        case CHANNEL_PULSE2: {
+            const struct Pulse *pulse = &apu->pulse[channel];
+            if (!pulse->length || pulseMuted(pulse, channel) || !duties[pulse->duty][pulse->phase]) {
+                return 0;
+            }
+            return volume(&pulse->envelope);
+        }
+        case CHANNEL_TRIANGLE:
+            return triangleSteps[apu->triangle.phase];
+        case CHANNEL_NOISE:
+            return (apu->noise.length && !(apu->noise.shift & 1)) ? volume(&apu->noise.envelope) : 0;
+        default:
+            return apu->dmc.level;
+    }
+}
+
+/*
+    Whether running the channel's timer could change what it outputs. A
+    channel that can't is left stopped until a write or the frame counter
+    changes that. Triangle periods under two are ultrasonic and only pop,
+    so the triangle holds its step for those.
+*/
+static int active(const struct APU *apu, int channel) {
+    switch (channel) {
+        case CHANNEL_PULSE1:
+        case CHANNEL_PULSE2: {
+            const struct Pulse *pulse = &apu->pulse[channel];
+            return pulse->length && !pulseMuted(pulse, channel) && volume(&pulse->envelope);
+        }
+        case CHANNEL_TRIANGLE:
+            return apu->triangle.length && apu->triangle.linear && apu->triangle.timer >= 2;
+        case CHANNEL_NOISE:
+            return apu->noise.length && volume(&apu->noise.envelope);
+        default:
+            return !apu->dmc.silent || apu->dmc.bufferFull || apu->dmc.remaining;
+    }
+}
+
+static uint32_t period(const struct APU *apu, int channel) {
+    switch (channel) {
+        case CHANNEL_PULSE1:
+        case CHANNEL_PULSE2:
+            return (apu->pulse[channel].timer + 1) * 2;
+        case CHANNEL_TRIANGLE:
+            return apu->triangle.timer + 1;
+        case CHANNEL_NOISE:
+            return noisePeriods[apu->noise.period];
+        default:
+            return dmcPeriods[apu->dmc.rate];
+    }
+}
+
+/*
+    Reads the next sample byte if the buffer has room, raising the DMC
+    interrupt when a sample that doesn't loop runs out. The read halts the
+    CPU for a few cycles, fewer if it lands inside an OAM DMA that has
+    already halted it.
+*/
+static void fetchSample(struct APU *apu) {
+    struct DMC *dmc = &apu->dmc;
+    if (dmc->bufferFull || !dmc->remaining) {
+        return;
+    }
+    dmc->buffer = apu->prg[(dmc->address >> 12) & 7][dmc->address & 0x0FFF];
+    *apu->stall += (apu->time < apu->oamDmaEnd) ? DMC_STALL_OAM : DMC_STALL;
+    dmc->bufferFull = 1;
+    dmc->address = (dmc->address == 0xFFFF) ? 0x8000 : dmc->address + 1;
+    if (--dmc->remaining == 0) {
+        if (dmc->loop) {
+            dmc->address = dmc->start;
+            dmc->remaining = dmc->length;
+        }
+        else if (dmc->irqEnabled) {
+            apu->dmcInterrupt = 1;
+        }
+    }
+}
+
+/*
+    How many times the channel's timer runs out, counting the next, before
+    its output can change. A pulse holds each level of its duty for a run
+    of steps and the triangle repeats its top and bottom steps.
+*/
+static uint32_t run(const struct APU *apu, int channel) {
+    switch (channel) {
+        case CHANNEL_PULSE1:
+        case CHANNEL_PULSE2:
+            return runs[apu->pulse[channel].duty][apu->pulse[channel].phase];
+        case CHANNEL_TRIANGLE:
+            return ((apu->triangle.phase & 15) == 15) ? 2 : 1;
+        default:
+            return 1;
+    }
+}
+
+static void clockNoise(struct Noise *noise) {
+    uint16_t feedback = (noise->shift ^ (noise->shift >> (noise->mode ? 6 : 1))) & 1;
+    noise->shift = (noise->shift >> 1) | (feedback << 14);
+}
+
+/*
+    The noise shift register is linear, so clocking it n times is a 15 by
+    15 bit matrix raised to the n. noiseJumps[mode][k] holds the columns of
+    the matrix for 2^k clocks. Mode 0's sequence repeats every 32767 clocks
+    and every one of mode 1's within 93, so a count is reduced by that
+    first. A jump costs 15 column XORs, about what 8 clocks do, and most
+    advances while the noise plays are a clock or two, so the count's low
+    bits are clocked and only the rest jumped: at most 7 clocks and 12
+    jumps.
+*/
+#define NOISE_CLOCKED 8
+
+static const uint16_t noiseCycles[2] = { 32767, 93 };
+static uint16_t noiseJumps[2][15][15];
+static int noiseJumpsReady = 0;
+
+static uint16_t jumpNoise(const uint16_t *columns, uint16_t shift) {
+    uint16_t result = 0;
+    for (int bit = 0; bit < 15; bit++) {
+        result ^= columns[bit] & -((shift >> bit) & 1);
+    }
+    return result;
+}
+
+static void buildNoiseJumps() {
+    for (int mode = 0; mode < 2; mode++) {
+        for (int bit = 0; bit < 15; bit++) {
+            struct Noise noise = { .mode = mode, .shift = 1 << bit };
+            clockNoise(&noise);
+            noiseJumps[mode][0][bit] = noise.shift;
+        }
+        for (int k = 1; k < 15; k++) {
+            for (int bit = 0; bit < 15; bit++) {
+                noiseJumps[mode][k][bit] = jumpNoise(noiseJumps[mode][k - 1], noiseJumps[mode][k - 1][bit]);
+            }
+        }
+    }
+    noiseJumpsReady = 1;
+}
+
+/*
+    One run out of the DMC's timer, which plays a bit and may empty the
+    buffer into the shifter
+*/
+static void clockDmc(struct APU *apu) {
+    struct DMC *dmc = &apu->dmc;
+    if (!dmc->silent) {
+        if (dmc->shift & 1) {
+            dmc->level += (dmc->level <= 125) ? 2 : 0;
+        }
+        else {
+            dmc->level -= (dmc->level >= 2) ? 2 : 0;
+        }
+    }
+    dmc->shift >>= 1;
+    if (--dmc->bits == 0) {
+        dmc->bits = 8;
+        dmc->silent = !dmc->bufferFull;
+        dmc->shift = dmc->buffer;
+        dmc->bufferFull = 0;
+        fetchSample(apu);
+    }
+}
+
+/*
+    Runs the channel's timer out every time it would have before time, in
+    one go. Timers keep running while their channel is idle so it picks up
+    again in phase. The DMC is only ever advanced this way while it has
+    nothing to play, when all its timer does is count bits.
+*/
+static void advance(struct APU *apu, int channel, uint64_t time) {
+    uint64_t next = apu->next[channel];
+    if (next >= time) {
+        return;
+    }
+    uint32_t length = period(apu, channel);
+    uint64_t steps = (time - next - 1) / length + 1;
+    apu->next[channel] = next + steps * length;
+    switch (channel) {
+        case CHANNEL_PULSE1:
+        case CHANNEL_PULSE2:
+            apu->pulse[channel].phase = (apu->pulse[channel].phase - steps) & 7;
+            break;
+        case CHANNEL_TRIANGLE:
+            if (active(apu, CHANNEL_TRIANGLE)) {
+                apu->triangle.phase = (apu->triangle.phase + steps) & 31;
+            }
+            break;
+        case CHANNEL_NOISE: {
+            int mode = apu->noise.mode ? 1 : 0;
+            uint32_t count = (uint32_t)(steps % noiseCycles[mode]);
+            for (uint32_t i = 0; i < (count & (NOISE_CLOCKED - 1)); i++) {
+                clockNoise(&apu->noise);
+            }
+            count /= NOISE_CLOCKED;
+            for (int k = __builtin_ctz(NOISE_CLOCKED); count != 0; k++, count >>= 1) {
+                if (count & 1) {
+                    apu->noise.shift = jumpNoise(noiseJumps[mode][k], apu->noise.shift);
+                }
+            }
+            break;
+        }
+        default:
+            apu->dmc.bits = (uint8_t)((apu->dmc.bits + 7 - steps % 8) % 8 + 1);
+            break;
+    }
+}
+
+/*
+    The cycle the channel's output can next change on, if it can at all
+*/
+static uint64_t due(const struct APU *apu, int channel) {
+    if (!active(apu, channel)) {
+        return SCHEDULER_NEVER;
+    }
+    return apu->next[channel] + (uint64_t)(run(apu, channel) - 1) * period(apu, channel);
+}
+
+static void settle(struct APU *apu, uint64_t time) {
+    for (int channel = 0; channel < APU_CHANNELS; channel++) {
+        advance(apu, channel, time);
+    }
+}
+
+
+/* -------------
+    Frame counter
+    ------------ */
+static void clockEnvelope(struct Envelope *envelope) {
+    if (envelope->start) {
+        envelope->start = 0;
+        envelope->decay = 15;
+        envelope->divider = envelope->period;
+    }
+    else if (envelope->divider == 0) {
+        envelope->divider = envelope->period;
+        if (envelope->decay) {
+            envelope->decay--;
+        }
+        else if (envelope->loop) {
+            envelope->decay = 15;
+        }
+    }
+    else {
+        envelope->divider--;
+    }
+}
+
+static void clockSweep(struct Pulse *pulse, int channel) {
+    if (pulse->sweepDivider == 0 && pulse->sweepEnabled && pulse->sweepShift && !pulseMuted(pulse, channel)) {
+        pulse->timer = sweepTarget(pulse, channel);
+    }
+    if (pulse->sweepDivider == 0 || pulse->sweepReload) {
+        pulse->sweepDivider = pulse->sweepPeriod;
+        pulse->sweepReload = 0;
+    }
+    else {
+        pulse->sweepDivider--;
+    }
+}
+
+static void clockQuarter(struct APU *apu) {
+    clockEnvelope(&apu->pulse[0].envelope);
+    clockEnvelope(&apu->pulse[1].envelope);
+    clockEnvelope(&apu->noise.envelope);
+    struct Triangle *triangle = &apu->triangle;
+    if (triangle->linearStart) {
+        triangle->linear = triangle->linearReload;
+    }
+    else if (triangle->linear) {
+        triangle->linear--;
+    }
+    if (!triangle->control) {
+        triangle->linearStart = 0;
+    }
+}
+
+static void clockHalf(struct APU *apu) {
+    for (int channel = CHANNEL_PULSE1; channel <= CHANNEL_PULSE2; channel++) {
+        struct Pulse *pulse = &apu->pulse[channel];
+        if (pulse->length && !pulse->envelope.loop) {
+            pulse->length--;
+        }
+        clockSweep(pulse, channel);
+    }
+    if (apu->triangle.length && !apu->triangle.control) {
+        apu->triangle.length--;
+    }
+    if (apu->noise.length && !apu->noise.envelope.loop) {
+        apu->noise.length--;
+    }
+}
+
+static void clockFrame(struct APU *apu) {
+    const uint16_t *steps = frameSteps[apu->fiveStep];
+    uint64_t sequenceStart = apu->frameNext - steps[apu->frameStep];
+    clockQuarter(apu);
+    if (apu->frameStep & 1) {
+        clockHalf(apu);
+    }
+    if (apu->frameStep == 3) {
+        apu->frameInterrupt |= !apu->fiveStep && !apu->irqInhibit;
+        sequenceStart += steps[4];
+        apu->frameStep = 0;
+    }
+    else {
+        apu->frameStep++;
+    }
+    apu->frameNext = sequenceStart + steps[apu->frameStep];
+}
+
+
+/* ---------
+    Mixing
+    -------- */
+
+/*
+    The NES mixes its channels through two nonlinear resistor networks,
+    one for the pulses and one for the rest. Each network's output depends
+    only on a weighted sum of its inputs, so both are tabulated once: the
+    pulses by their sum and the rest by 3 triangle + 2 noise + DMC.
+*/
+static int pulseLevels[31];
+static int tndLevels[203];
+static int levelsReady = 0;
+
+static void buildLevels() {
+    for (int i = 1; i < 31; i++) {
+        pulseLevels[i] = (int)(95.52 / (8128.0 / i + 100.0) * AMPLITUDE + 0.5);
+    }
+    for (int i = 1; i < 203; i++) {
+        tndLevels[i] = (int)(163.67 / (24329.0 / i + 100.0) * AMPLITUDE + 0.5);
+    }
+    levelsReady = 1;
+}
+
+static int mix(const uint8_t *outputs) {
+    return pulseLevels[outputs[CHANNEL_PULSE1] + outputs[CHANNEL_PULSE2]] + tndLevels[3 * outputs[CHANNEL_TRIANGLE] + 2 * outputs[CHANNEL_NOISE] + outputs[CHANNEL_DMC]];
+}
+
+/*
+    Passes any change in the mixed level at the current time on to the
+    step buffer
+*/
+static void updateLevel(struct APU *apu) {
+    int level = mix(apu->outputs);
+    if (level != apu->level) {
+        blip_addDelta(&apu->blip, (uint32_t)(apu->time - apu->frameTime), level - apu->level);
+        apu->level = level;
+    }
+}
+
+/*
+    After anything other than a channel's own timer has changed it: picks
+    up new outputs and when each channel can next change them
+*/
+static void refresh(struct APU *apu) {
+    for (int channel = 0; channel < APU_CHANNELS; channel++) {
+        apu->outputs[channel] = output(apu, channel);
+        apu->due[channel] = due(apu, channel);
+    }
+    updateLevel(apu);
+}
+
+
+/* ---------
+    Timing
+    -------- */
+
+/*
+    Sets the scheduler to wake the APU on the cycle after the next thing
+    the CPU would notice: the four step sequence's last step, which can
+    raise an interrupt, or the DMC's next fetch, which steals cycles and
+    can raise one too. Nothing else the APU does is seen by the CPU until
+    it reads or writes a register. The buffer is refilled as soon as it
+    empties, so while bytes remain it is full and the next fetch is when
+    the shifter next runs out.
+*/
+static void scheduleWake(struct APU *apu) {
+    uint64_t time = SCHEDULER_NEVER;
+    if (!apu->fiveStep && !apu->irqInhibit) {
+        time = apu->frameNext - frameSteps[0][apu->frameStep] + frameSteps[0][3];
+    }
+    const struct DMC *dmc = &apu->dmc;
+    if (dmc->remaining) {
+        uint64_t fetch = apu->next[CHANNEL_DMC] + (uint64_t)(dmc->bits - 1) * dmcPeriods[dmc->rate];
+        if (fetch < time) {
+            time = fetch;
+        }
+    }
+    if (time == SCHEDULER_NEVER) {
+        scheduler_cancel(apu->scheduler, EVENT_APU);
+    }
+    else {
+        scheduler_schedule(apu->scheduler, EVENT_APU, (time + 1) * CPU_DOTS);
+    }
+}
+
+static void handleEvent(void *context, enum Event event) {
+    struct APU *apu = (struct APU*)context;
+    apu_catchUp(apu);
+    scheduleWake(apu);
+}
+
+void apu_init(struct APU *apu, struct Scheduler *scheduler, int sampleRate) {
+    if (!levelsReady) {
+        buildLevels();
+    }
+    if (!noiseJumpsReady) {
+        buildNoiseJumps();
+    }
+    memset(apu, 0, sizeof(struct APU));
+    apu->scheduler = scheduler;
+    apu->time = scheduler->now / CPU_DOTS;
+    apu->frameTime = apu->time;
+    apu->frameNext = apu->time + frameSteps[0][0];
+    apu->noise.shift = 1;
+    apu->dmc.bits = 8;
+    apu->dmc.silent = 1;
+    for (int channel = 0; channel < APU_CHANNELS; channel++) {
+        apu->next[channel] = apu->time + period(apu, channel);
+    }
+    blip_init(&apu->blip, APU_CLOCK_RATE, sampleRate);
+    refresh(apu);
+    scheduler_setHandler(scheduler, EVENT_APU, &handleEvent, apu);
+    scheduleWake(apu);
+}
+
+/*
+    Hooks the DMC up to the cartridge's PRG windows and to the count of
+    cycles the CPU has to give up
+*/
+void apu_connect(struct APU *apu, uint8_t *const *prg, int *stall) {
+    apu->prg = prg;
+    apu->stall = stall;
+}
+
+/*
+    Notes an OAM DMA that halts the CPU for cycles from now, so DMC fetches
+    that fall inside it cost less
+*/
+void apu_oamDma(struct APU *apu, int cycles) {
+    apu_catchUp(apu);
+    apu->oamDmaEnd = apu->time + cycles;
+}
+
+/*
+    Runs the APU up to the CPU cycle the scheduler is on, visiting only the
+    cycles where a channel's output can change or the frame counter steps.
+    Timer run outs in between are caught up in one go whenever anything
+    else needs the channels to be current.
+*/
+void apu_catchUp(struct APU *apu) {
+    uint64_t now = apu->scheduler->now / CPU_DOTS;
+    for (;;) {
+        uint64_t earliest = apu->frameNext;
+        int channel = -1;
+        for (int i = 0; i < APU_CHANNELS; i++) {
+            if (apu->due[i] < earliest) {
+                earliest = apu->due[i];
+                channel = i;
+            }
+        }
+        if (earliest >= now) {
+            break;
+        }
+        apu->time = earliest;
+        if (channel < 0) {
+            settle(apu, earliest);
+            clockFrame(apu);
+            refresh(apu);
+        }
+        else if (channel == CHANNEL_DMC) {
+            clockDmc(apu);
+            apu->next[CHANNEL_DMC] += period(apu, CHANNEL_DMC);
+            refresh(apu);
+        }
+        else {
+            advance(apu, channel, earliest + 1);
+            apu->outputs[channel] = output(apu, channel);
+            apu->due[channel] = due(apu, channel);
+            updateLevel(apu);
+        }
+    }
+    apu->time = now;
+    settle(apu, now);
+}
+
+
+/* ----------
+    Registers
+    --------- */
+static void writePulse(struct APU *apu, struct Pulse *pulse, int channel, uint16_t address, uint8_t data) {
+    switch (address & 3) {
+        case 0:
+            pulse->duty = data >> 6;
+            pulse->envelope.loop = (data >> 5) & 1;
+            pulse->envelope.constant = (data >> 4) & 1;
+            pulse->envelope.period = data & 0x0F;
+            break;
+        case 1:
+            pulse->sweepEnabled = data >> 7;
+            pulse->sweepPeriod = (data >> 4) & 0x07;
+            pulse->sweepNegate = (data >> 3) & 1;
+            pulse->sweepShift = data & 0x07;
+            pulse->sweepReload = 1;
+            break;
+        case 2:
+            pulse->timer = (pulse->timer & 0x0700) | data;
+            break;
+        case 3:
+            pulse->timer = (pulse->timer & 0x00FF) | ((uint16_t)(data & 0x07) << 8);
+            if (apu->enabled & (1 << channel)) {
+                pulse->length = lengths[data >> 3];
+            }
+            pulse->phase = 0;
+            pulse->envelope.start = 1;
+            break;
+    }
+}
+
+static void writeTriangle(struct APU *apu, uint16_t address, uint8_t data) {
+    struct Triangle *triangle = &apu->triangle;
+    switch (address & 3) {
+        case 0:
+            triangle->control = data >> 7;
+            triangle->linearReload = data & 0x7F;
+            break;
+        case 2:
+            triangle->timer = (triangle->timer & 0x0700) | data;
+            break;
+        case 3:
+            triangle->timer = (triangle->timer & 0x00FF) | ((uint16_t)(data & 0x07) << 8);
+            if (apu->enabled & (1 << CHANNEL_TRIANGLE)) {
+                triangle->length = lengths[data >> 3];
+            }
+            triangle->linearStart = 1;
+            break;
+    }
+}
+
+static void writeNoise(struct APU *apu, uint16_t address, uint8_t data) {
+    struct Noise *noise = &apu->noise;
+    switch (address & 3) {
+        case 0:
+            noise->envelope.loop = (data >> 5) & 1;
+            noise->envelope.constant = (data >> 4) & 1;
+            noise->envelope.period = data & 0x0F;
+            break;
+        case 2:
+            noise->mode = data >> 7;
+            noise->period = data & 0x0F;
+            break;
+        case 3:
+            if (apu->enabled & (1 << CHANNEL_NOISE)) {
+                noise->length = lengths[data >> 3];
+            }
+            noise->envelope.start = 1;
+            break;
+    }
+}
+
+static void writeDmc(struct APU *apu, uint16_t address, uint8_t data) {
+    struct DMC *dmc = &apu->dmc;
+    switch (address & 3) {
+        case 0:
+            dmc->irqEnabled = data >> 7;
+            dmc->loop = (data >> 6) & 1;
+            dmc->rate = data & 0x0F;
+            if (!dmc->irqEnabled) {
+                apu->dmcInterrupt = 0;
+            }
+            break;
+        case 1:
+            dmc->level = data & 0x7F;
+            break;
+        case 2:
+            dmc->start = 0xC000 | ((uint16_t)data << 6);
+            break;
+        case 3:
+            dmc->length = ((uint16_t)data << 4) | 1;
+            break;
+    }
+}
+
+/*
+    Disabling a channel zeroes its length counter. Enabling the DMC starts
+    its sample over only if the last one has finished.
+*/
+static void writeStatus(struct APU *apu, uint8_t data) {
+    apu->enabled = data & 0x1F;
+    if (!(data & 0x01)) {
+        apu->pulse[0].length = 0;
+    }
+    if (!(data & 0x02)) {
+        apu->pulse[1].length = 0;
+    }
+    if (!(data & 0x04)) {
+        apu->triangle.length = 0;
+    }
+    if (!(data & 0x08)) {
+        apu->noise.length = 0;
+    }
+    struct DMC *dmc = &apu->dmc;
+    if (!(data & 0x10)) {
+        dmc->remaining = 0;
+    }
+    else if (!dmc->remaining) {
+        dmc->address = dmc->start;
+        dmc->remaining = dmc->length;
+        fetchSample(apu);
+    }
+    apu->dmcInterrupt = 0;
+}
+
+/*
+    Restarts the frame counter sequence. The five step mode clocks the
+    envelopes, lengths and sweeps straight away.
+*/
+static void writeFrameCounter(struct APU *apu, uint8_t data) {
+    apu->fiveStep = data >> 7;
+    apu->irqInhibit = (data >> 6) & 1;
+    if (apu->irqInhibit) {
+        apu->frameInterrupt = 0;
+    }
+    apu->frameStep = 0;
+    apu->frameNext = apu->time + frameSteps[apu->fiveStep][0];
+    if (apu->fiveStep) {
+        clockQuarter(apu);
+        clockHalf(apu);
+    }
+}
+
+void apu_writeRegister(struct APU *apu, uint16_t address, uint8_t data) {
+    apu_catchUp(apu);
+    if (address < 0x4008) {
+        int channel = (address >> 2) & 1;
+        writePulse(apu, &apu->pulse[channel], channel, address, data);
+    }
+    else if (address < 0x400C) {
+        writeTriangle(apu, address, data);
+    }
+    else if (address < 0x4010) {
+        writeNoise(apu, address, data);
+    }
+    else if (address < 0x4014) {
+        writeDmc(apu, address, data);
+    }
+    else if (address == 0x4015) {
+        writeStatus(apu, data);
+    }
+    else if (address == 0x4017) {
+        writeFrameCounter(apu, data);
+    }
+    refresh(apu);
+    scheduleWake(apu);
+}
+
+/*
+    Which channels are still playing and which interrupts are up. Reading
+    acknowledges the frame interrupt.
+*/
+uint8_t apu_readStatus(struct APU *apu) {
+    apu_catchUp(apu);
+    uint8_t status = (apu->pulse[0].length ? 0x01 : 0) | (apu->pulse[1].length ? 0x02 : 0) | (apu->triangle.length ? 0x04 : 0) | (apu->noise.length ? 0x08 : 0) | (apu->dmc.remaining ? 0x10 : 0) | (apu->frameInterrupt ? 0x40 : 0) | (apu->dmcInterrupt ? 0x80 : 0);
+    apu->frameInterrupt = 0;
+    return status;
+}
+
+
+/* -------
+    Output
+    ------ */
+
+/*
+    Finishes the samples up to now so they can be read
+*/
+void apu_endFrame(struct APU *apu) {
+    apu_catchUp(apu);
+    if (apu->expansion != NULL) {
+        expansion_catchUp(apu->expansion);
+    }
+    blip_endFrame(&apu->blip, (uint32_t)(apu->time - apu->frameTime));
+    apu->frameTime = apu->time;
+}
+
+/*
+    Takes effect from the end of the last frame
+*/
+void apu_setSampleRate(struct APU *apu, double sampleRate) {
+    blip_setRates(&apu->blip, APU_CLOCK_RATE, sampleRate);
+}
+
+int apu_readSamples(struct APU *apu, int16_t *out, int count) {
+    return blip_read(&apu->blip, out, count);
+}
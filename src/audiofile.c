@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "./headers/audiofile.h"
+
+/*
+    Streams samples to a file or standard output with no device behind it,
+    for batch runs. Samples are gathered into one large buffer and written
+    when it fills. A path ending in .wav gets a header, anything else gets
+    bare 16 bit little endian mono. Every sample also goes into a running
+    hash, so a run can be checked against a known one without keeping the
+    file, or with no path at all. A failed or short write marks the stream
+    failed, so a full disk is reported on close instead of passing for a
+    finished file.
+*/
+static const char *path = NULL;
+static FILE *file = NULL;
+static int wav = 0;
+static int failed = 0;
+static int rate = 0;
+static int16_t buffer[AUDIO_FILE_BUFFER];
+static unsigned buffered = 0;
+static uint32_t written = 0;
+static uint32_t hash = 2166136261u;
+
+
+/* -------------
+    WAV header
+    ------------ */
+static void put16(uint8_t *out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static void put32(uint8_t *out, uint32_t value) {
+    put16(out, value & 0xFFFF);
+    put16(out + 2, value >> 16);
+}
+
+/*
+    A stream's length isn't known until it ends, so the sizes start out as
+    large as they can be, which players read as "until the data stops",
+    and are filled in on close if the file can seek
+*/
+static void writeHeader(uint32_t samples) {
+    uint8_t header[44];
+    uint32_t bytes = (samples >= 0x7FFFFFFF) ? 0xFFFFFFFF - 36 : samples * 2;
+    memcpy(header, "RIFF", 4);
+    put32(header + 4, bytes + 36);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put32(header + 16, 16);
+    put16(header + 20, 1);
+    put16(header + 22, 1);
+    put32(header + 24, rate);
+    put32(header + 28, rate * 2);
+    put16(header + 32, 2);
+    put16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    put32(header + 40, bytes);
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+        failed = 1;
+    }
+}
+
+
+/* ---------
+    Sink
+    -------- */
+static void flush() {
+    if (file != NULL && buffered && !failed && fwrite(buffer, sizeof(int16_t), buffered, file) != buffered) {
+        failed = 1;
+    }
+    buffered = 0;
+}
+
+/*
+    Must be called before open, "-" is standard output and NULL only hashes
+*/
+void audiofile_setPath(const char *newPath) {
+    path = newPath;
+}
+
+static int openFile(int sampleRate) {
+    rate = sampleRate;
+    buffered = 0;
+    written = 0;
+    failed = 0;
+    hash = 2166136261u;
+    if (path == NULL) {
+        return rate;
+    }
+    if (strcmp(path, "-") == 0) {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        file = stdout;
+    }
+    else {
+        file = fopen(path, "wb");
+        if (file == NULL) {
+            printf("Could not open %s for writing\n", path);
+            return 0;
+        }
+    }
+    size_t length = strlen(path);
+    wav = length > 4 && strcmp(path + length - 4, ".wav") == 0;
+    if (wav) {
+        writeHeader(0xFFFFFFFF);
+    }
+    return rate;
+}
+
+static void writeFile(const int16_t *samples, int count) {
+    for (int i = 0; i < count; i++) {
+        hash = (hash ^ (uint16_t)samples[i]) * 16777619u;
+    }
+    written += count;
+    while (count > 0) {
+        int room = AUDIO_FILE_BUFFER - buffered;
+        int chunk = (count < room) ? count : room;
+        memcpy(buffer + buffered, samples, chunk * sizeof(int16_t));
+        buffered += chunk;
+        samples += chunk;
+        count -= chunk;
+        if (buffered == AUDIO_FILE_BUFFER) {
+            flush();
+        }
+    }
+}
+
+/*
+    Nothing plays the samples, so there is never anything to wait for
+*/
+static void paceFile(unsigned target) {
+}
+
+static void statsFile(struct AudioStats *stats) {
+    stats->fill = buffered;
+    stats->underruns = 0;
+    stats->overruns = 0;
+    stats->paceTimeouts = 0;
+}
+
+/*
+    Returns 0 if anything failed to reach the file, including the buffered
+    tail that only the final flush or fclose finds out about
+*/
+static int closeFile() {
+    flush();
+    if (file == NULL) {
+        return 1;
+    }
+    if (wav && file != stdout && !failed && fseek(file, 0, SEEK_SET) == 0) {
+        writeHeader(written);
+    }
+    if (ferror(file)) {
+        failed = 1;
+    }
+    const char *name = path;
+    if (file == stdout) {
+        name = "standard output";
+        if (fflush(file) != 0) {
+            failed = 1;
+        }
+    }
+    else if (fclose(file) != 0) {
+        failed = 1;
+    }
+    file = NULL;
+    if (failed) {
+        fprintf(stderr, "Could not write %s\n", name);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+    FNV-1a of every sample written since open
+*/
+uint32_t audiofile_hash() {
+    return hash;
+}
+
+const struct AudioSink audiofile_sink = { "file", 0, &openFile, &writeFile, &paceFile, &statsFile, &closeFile };
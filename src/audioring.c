@@ -0,0 +1,75 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "./headers/audioring.h"
+
+
+void audioring_init(struct AudioRing *ring) {
+    memset(ring->samples, 0, sizeof(ring->samples));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->underruns, 0);
+    atomic_init(&ring->overruns, 0);
+    ring->last = 0;
+}
+
+/*
+    Copies count samples from data into the ring starting at position, in
+    two pieces if they wrap
+*/
+static void copyIn(struct AudioRing *ring, unsigned position, const int16_t *data, int count) {
+    unsigned start = position & (AUDIO_RING_SIZE - 1);
+    int first = (AUDIO_RING_SIZE - start < (unsigned)count) ? (int)(AUDIO_RING_SIZE - start) : count;
+    memcpy(ring->samples + start, data, first * sizeof(int16_t));
+    memcpy(ring->samples, data + first, (count - first) * sizeof(int16_t));
+}
+
+static void copyOut(struct AudioRing *ring, unsigned position, int16_t *data, int count) {
+    unsigned start = position & (AUDIO_RING_SIZE - 1);
+    int first = (AUDIO_RING_SIZE - start < (unsigned)count) ? (int)(AUDIO_RING_SIZE - start) : count;
+    memcpy(data, ring->samples + start, first * sizeof(int16_t));
+    memcpy(data + first, ring->samples, (count - first) * sizeof(int16_t));
+}
+
+/*
+    Producer side. Returns how many samples fitted.
+*/
+int audioring_write(struct AudioRing *ring, const int16_t *samples, int count) {
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    unsigned space = AUDIO_RING_SIZE - (head - tail);
+    if ((unsigned)count > space) {
+        count = (int)space;
+        atomic_fetch_add_explicit(&ring->overruns, 1, memory_order_relaxed);
+    }
+    copyIn(ring, head, samples, count);
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+    return count;
+}
+
+/*
+    Consumer side, always fills all count samples of out
+*/
+void audioring_read(struct AudioRing *ring, int16_t *out, int count) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    int available = (int)(head - tail);
+    int taken = (count < available) ? count : available;
+    copyOut(ring, tail, out, taken);
+    atomic_store_explicit(&ring->tail, tail + taken, memory_order_release);
+    if (taken > 0) {
+        ring->last = out[taken - 1];
+    }
+    if (taken < count) {
+        for (int i = taken; i < count; i++) {
+            out[i] = ring->last;
+        }
+        atomic_fetch_add_explicit(&ring->underruns, 1, memory_order_relaxed);
+    }
+}
+
+void audioring_stats(struct AudioRing *ring, struct AudioStats *stats) {
+    stats->fill = audioring_fill(ring);
+    stats->underruns = atomic_load_explicit(&ring->underruns, memory_order_relaxed);
+    stats->overruns = atomic_load_explicit(&ring->overruns, memory_order_relaxed);
+}
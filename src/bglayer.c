@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./headers/bglayer.h"
+#include "./headers/ppu.h"
+#include "./headers/ppufetch.h"
+
+#define LINE_BYTES 264
+
+
+struct BackgroundLayer *bglayer_create(void) {
+    struct BackgroundLayer *layer = malloc(sizeof(struct BackgroundLayer));
+    if (layer != NULL) {
+        bglayer_markAll(layer);
+    }
+    return layer;
+}
+
+void bglayer_markAll(struct BackgroundLayer *layer) {
+    memset(layer->dirty, 0xFF, sizeof(layer->dirty));
+    memset(layer->patterns, 0, sizeof(layer->patterns));
+    layer->patternsDirty = 0;
+}
+
+/*
+    A write to a nametable shows in every quadrant mirrored onto it. Names
+    dirty one tile, attribute bytes the 4 x 4 tiles they colour.
+*/
+void bglayer_markWrite(struct BackgroundLayer *layer, const struct PPU *ppu, uint16_t address) {
+    const uint8_t *table = ppu->nametableMap[(address >> 10) & 3];
+    uint16_t offset = address & 0x3FF;
+    for (int quadrant = 0; quadrant < 4; quadrant++) {
+        if (ppu->nametableMap[quadrant] != table) {
+            continue;
+        }
+        int top = (quadrant >> 1) * 30;
+        int left = (quadrant & 1) * 32;
+        if (offset < 0x3C0) {
+            layer->dirty[top + (offset >> 5)] |= 1ULL << (left + (offset & 0x1F));
+            continue;
+        }
+        int row = ((offset >> 3) & 0x07) * 4;
+        uint64_t columns = 0x0FULL << (left + (offset & 0x07) * 4);
+        for (int y = row; y < row + 4 && y < 30; y++) {
+            layer->dirty[top + y] |= columns;
+        }
+    }
+}
+
+/*
+    address is where in CHR the write landed. Which tiles show the pattern
+    is only worked out when a line is next fetched.
+*/
+void bglayer_markPattern(struct BackgroundLayer *layer, uint16_t address) {
+    uint16_t pattern = (address >> 4) & 0x1FF;
+    layer->patterns[pattern >> 6] |= 1ULL << (pattern & 0x3F);
+    layer->patternsDirty = 1;
+}
+
+static void markPatternTiles(struct BackgroundLayer *layer, const struct PPU *ppu) {
+    uint16_t table = (ppu->control & 0x10) << 4;
+    for (int row = 0; row < LAYER_ROWS; row++) {
+        for (int column = 0; column < LAYER_COLUMNS; column++) {
+            uint16_t v = ((row / 30) << 11) | ((column >> 5) << 10) | ((row % 30) << 5) | (column & 0x1F);
+            uint16_t pattern = table | ppu_nameAt(ppu, v);
+            if (layer->patterns[pattern >> 6] & (1ULL << (pattern & 0x3F))) {
+                layer->dirty[row] |= 1ULL << column;
+            }
+        }
+    }
+    memset(layer->patterns, 0, sizeof(layer->patterns));
+    layer->patternsDirty = 0;
+}
+
+static uint64_t rotate(uint64_t bits, int by) {
+    return by ? (bits << by) | (bits >> (64 - by)) : bits;
+}
+
+static void drawTile(struct BackgroundLayer *layer, const struct PPU *ppu, int row, int column) {
+    uint16_t v = ((row / 30) << 11) | ((column >> 5) << 10) | ((row % 30) << 5) | (column & 0x1F);
+    uint8_t name = ppu_nameAt(ppu, v);
+    uint64_t palette = ppu_paletteAt(ppu, v) * 0x0404040404040404ULL;
+    for (int y = 0; y < 8; y++) {
+        uint64_t pixels = ppu_patternRow(ppu, name, v | (y << 12)) | palette;
+        memcpy(&layer->pixels[row * 8 + y][column * 8], &pixels, sizeof(pixels));
+    }
+}
+
+/*
+    Fills the 33 tiles of background under the line starting at v, drawing
+    any of them that are dirty first. Returns 0 for the attribute rows,
+    which v can scroll into but the layer doesn't hold.
+*/
+int bglayer_fetchLine(struct BackgroundLayer *layer, const struct PPU *ppu, uint16_t v, uint8_t *line) {
+    int coarseY = (v >> 5) & 0x1F;
+    if (coarseY >= 30) {
+        return 0;
+    }
+    if (layer->patternsDirty) {
+        markPatternTiles(layer, ppu);
+    }
+    int row = ((v >> 11) & 1) * 30 + coarseY;
+    int column = ((v >> 10) & 1) * 32 + (v & 0x1F);
+    uint64_t columns = rotate(0x1FFFFFFFFULL, column);
+    uint64_t stale = layer->dirty[row] & columns;
+    while (stale) {
+        drawTile(layer, ppu, row, __builtin_ctzll(stale));
+        stale &= stale - 1;
+    }
+    layer->dirty[row] &= ~columns;
+
+    const uint8_t *pixels = layer->pixels[row * 8 + (v >> 12)];
+    int x = column * 8;
+    int first = (LAYER_WIDTH - x < LINE_BYTES) ? LAYER_WIDTH - x : LINE_BYTES;
+    memcpy(line, pixels + x, first);
+    memcpy(line + first, pixels, LINE_BYTES - first);
+    return 1;
+}
@@ -0,0 +1,180 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "./headers/blip.h"
+
+#define KERNEL_UNIT 32768
+#define BASS_SHIFT 9
+
+/*
+    The step's derivative, a windowed sinc, at each fraction of a sample it
+    can start on. Every phase sums to one unit so a step always ends up at
+    exactly its height once integrated.
+*/
+static int16_t kernel[BLIP_PHASES][BLIP_TAPS];
+static int kernelReady = 0;
+
+
+/* ---------------
+    Step kernels
+    -------------- */
+static void addStep_scalar(int32_t *out, const int16_t *taps, int delta) {
+    for (int tap = 0; tap < BLIP_TAPS; tap++) {
+        out[tap] += taps[tap] * delta;
+    }
+}
+
+const struct BlipKernels blip_scalar = { "scalar", &addStep_scalar };
+
+const struct BlipKernels *blip_kernels = &blip_scalar;
+
+static const struct BlipKernels *available[3];
+
+/*
+    Lists the backends this CPU can run, fastest first and always ending
+    with the scalar reference
+*/
+const struct BlipKernels **blip_kernelsAvailable() {
+    int count = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        available[count++] = &blip_sse2;
+    }
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    available[count++] = &blip_neon;
+#endif
+    available[count++] = &blip_scalar;
+    available[count] = NULL;
+    return available;
+}
+
+/*
+    Forces a backend by name, returns 0 if it is not available here. The
+    first blip_init picks the fastest, so this has to come after it.
+*/
+int blip_selectKernels(const char *name) {
+    for (const struct BlipKernels **kernels = blip_kernelsAvailable(); *kernels; kernels++) {
+        if (strcmp((*kernels)->name, name) == 0) {
+            blip_kernels = *kernels;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/* ---------------
+    Set up
+    -------------- */
+static void buildKernel() {
+    const double pi = 3.14159265358979323846;
+    const double cutoff = 0.9;
+    for (int phase = 0; phase < BLIP_PHASES; phase++) {
+        double taps[BLIP_TAPS];
+        double total = 0;
+        for (int tap = 0; tap < BLIP_TAPS; tap++) {
+            double x = tap - (BLIP_TAPS / 2 - 1) - (double)phase / BLIP_PHASES;
+            double sinc = (x == 0) ? 1.0 : sin(pi * x * cutoff) / (pi * x * cutoff);
+            double window = 0.42 + 0.5 * cos(pi * x / (BLIP_TAPS / 2)) + 0.08 * cos(2 * pi * x / (BLIP_TAPS / 2));
+            taps[tap] = (fabs(x) < BLIP_TAPS / 2) ? sinc * window : 0;
+            total += taps[tap];
+        }
+        int sum = 0;
+        for (int tap = 0; tap < BLIP_TAPS; tap++) {
+            kernel[phase][tap] = (int16_t)lround(taps[tap] * KERNEL_UNIT / total);
+            sum += kernel[phase][tap];
+        }
+        kernel[phase][BLIP_TAPS / 2 - 1] += KERNEL_UNIT - sum;
+    }
+    blip_kernels = blip_kernelsAvailable()[0];
+    kernelReady = 1;
+}
+
+void blip_init(struct Blip *blip, double clockRate, double sampleRate) {
+    if (!kernelReady) {
+        buildKernel();
+    }
+    memset(blip, 0, sizeof(struct Blip));
+    blip_setRates(blip, clockRate, sampleRate);
+}
+
+/*
+    Changing rates only affects times from the current frame start on
+*/
+void blip_setRates(struct Blip *blip, double clockRate, double sampleRate) {
+    blip->factor = (uint64_t)(sampleRate / clockRate * 4294967296.0 + 0.5);
+}
+
+
+/* ---------------
+    Writing
+    -------------- */
+
+/*
+    Adds a step of delta at time clocks into the frame. Steps past the end
+    of the buffer are lost, which only happens if nothing is reading.
+*/
+void blip_addDelta(struct Blip *blip, uint32_t time, int delta) {
+    uint64_t position = blip->offset + time * blip->factor;
+    uint32_t index = (uint32_t)(position >> 32);
+    if (index >= BLIP_SIZE) {
+        return;
+    }
+    const int16_t *taps = kernel[(position >> (32 - 5)) & (BLIP_PHASES - 1)];
+    if (delta == (int16_t)delta) {
+        blip_kernels->addStep(&blip->buffer[index], taps, delta);
+    }
+    else {
+        addStep_scalar(&blip->buffer[index], taps, delta);
+    }
+}
+
+/*
+    Ends the frame time clocks in, making every sample before it readable.
+    The next frame's times count from here.
+*/
+void blip_endFrame(struct Blip *blip, uint32_t time) {
+    blip->offset += time * blip->factor;
+    if ((blip->offset >> 32) > BLIP_SIZE) {
+        blip->offset = (uint64_t)BLIP_SIZE << 32 | (blip->offset & 0xFFFFFFFF);
+    }
+}
+
+
+/* ---------------
+    Reading
+    -------------- */
+
+/*
+    Integrates up to count finished samples into out, with a gentle high
+    pass to take the DC away, and returns how many there were
+*/
+int blip_read(struct Blip *blip, int16_t *out, int count) {
+    int available = blip_available(blip);
+    if (count > available) {
+        count = available;
+    }
+    int32_t integrator = blip->integrator;
+    for (int i = 0; i < count; i++) {
+        integrator += blip->buffer[i];
+        int32_t sample = integrator >> 15;
+        if (sample > INT16_MAX) {
+            sample = INT16_MAX;
+        }
+        else if (sample < INT16_MIN) {
+            sample = INT16_MIN;
+        }
+        out[i] = (int16_t)sample;
+        integrator -= sample * (1 << (15 - BASS_SHIFT));
+    }
+    blip->integrator = integrator;
+
+    int remaining = available - count + BLIP_TAPS;
+    memmove(blip->buffer, blip->buffer + count, remaining * sizeof(int32_t));
+    memset(blip->buffer + remaining, 0, count * sizeof(int32_t));
+    blip->offset -= (uint64_t)count << 32;
+    return count;
+}
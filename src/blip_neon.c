@@ -0,0 +1,16 @@
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+#include <stdint.h>
+
+#include "./headers/blip.h"
+
+static void addStep_neon(int32_t *out, const int16_t *taps, int delta) {
+    for (int tap = 0; tap < BLIP_TAPS; tap += 4) {
+        vst1q_s32(out + tap, vmlal_n_s16(vld1q_s32(out + tap), vld1_s16(taps + tap), (int16_t)delta));
+    }
+}
+
+const struct BlipKernels blip_neon = { "neon", &addStep_neon };
+
+#endif
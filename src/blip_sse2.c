@@ -0,0 +1,27 @@
+#if defined(__x86_64__) || defined(__i386__)
+#pragma GCC target("sse2")
+
+#include <emmintrin.h>
+#include <stdint.h>
+
+#include "./headers/blip.h"
+
+/*
+    SSE2 has no 32 bit multiply, so each product is put back together from
+    the low and high halves of a 16 bit one
+*/
+static void addStep_sse2(int32_t *out, const int16_t *taps, int delta) {
+    __m128i height = _mm_set1_epi16((int16_t)delta);
+    for (int tap = 0; tap < BLIP_TAPS; tap += 8) {
+        __m128i t = _mm_loadu_si128((const __m128i *)(taps + tap));
+        __m128i low = _mm_mullo_epi16(t, height);
+        __m128i high = _mm_mulhi_epi16(t, height);
+        __m128i *o = (__m128i *)(out + tap);
+        _mm_storeu_si128(o, _mm_add_epi32(_mm_loadu_si128(o), _mm_unpacklo_epi16(low, high)));
+        _mm_storeu_si128(o + 1, _mm_add_epi32(_mm_loadu_si128(o + 1), _mm_unpackhi_epi16(low, high)));
+    }
+}
+
+const struct BlipKernels blip_sse2 = { "sse2", &addStep_sse2 };
+
+#endif
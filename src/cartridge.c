@@ -0,0 +1,113 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "./headers/cartridge.h"
+#include "./headers/ppu.h"
+#include "./headers/expansion.h"
+
+
+/*
+    Reads an iNES image, rom must be positioned just past the "NES\x1A" tag
+*/
+int cartridge_load(struct Cartridge *cartridge, FILE *rom) {
+    uint8_t header[12];
+    if (fread(header, 1, sizeof(header), rom) != sizeof(header)) {
+        return 0;
+    }
+    cartridge->prgSize = header[0] * 0x4000;
+    if (cartridge->prgSize == 0) {
+        return 0;
+    }
+    cartridge->chrSize = header[1] * 0x2000;
+    cartridge->mapper = (header[3] & 0xF0) | (header[2] >> 4);
+    if (header[2] & 0x08) {
+        cartridge->mirroring = MIRROR_FOUR_SCREEN;
+    }
+    else {
+        cartridge->mirroring = (header[2] & 0x01) ? MIRROR_VERTICAL : MIRROR_HORIZONTAL;
+    }
+    if (header[2] & 0x04) {
+        fseek(rom, 512, SEEK_CUR);
+    }
+
+    cartridge->prg = malloc(cartridge->prgSize);
+    cartridge->chr = (cartridge->chrSize) ? malloc(cartridge->chrSize) : NULL;
+    if (cartridge->prg == NULL || (cartridge->chrSize && cartridge->chr == NULL)) {
+        cartridge_free(cartridge);
+        return 0;
+    }
+    if (fread(cartridge->prg, 1, cartridge->prgSize, rom) != cartridge->prgSize
+        || fread(cartridge->chr, 1, cartridge->chrSize, rom) != cartridge->chrSize) {
+        cartridge_free(cartridge);
+        return 0;
+    }
+    if (cartridge->mapper != 0 && cartridge->mapper != 3) {
+        printf("Mapper %d is not supported\n", cartridge->mapper);
+        cartridge_free(cartridge);
+        return 0;
+    }
+    for (int window = 0; window < 8; window++) {
+        cartridge_mapPrg(cartridge, window, window);
+    }
+    return 1;
+}
+
+void cartridge_free(struct Cartridge *cartridge) {
+    free(cartridge->prg);
+    free(cartridge->chr);
+    free(cartridge->prgRam);
+    cartridge->prg = NULL;
+    cartridge->chr = NULL;
+    cartridge->prgRam = NULL;
+}
+
+
+/* --------
+    Mappers
+    ------- */
+
+/*
+    Points one 4KB window of $8000-$FFFF at a bank of PRG. Banks past the
+    end wrap round, which also mirrors a 16KB PRG into both halves.
+*/
+void cartridge_mapPrg(struct Cartridge *cartridge, int window, uint32_t bank) {
+    cartridge->prgWindows[window] = cartridge->prg + (bank * 0x1000) % cartridge->prgSize;
+}
+
+uint8_t cartridge_cpuRead(struct Cartridge *cartridge, uint16_t address) {
+    if (address >= 0x8000) {
+        return cartridge->prgWindows[(address >> 12) & 7][address & 0x0FFF];
+    }
+    if (address < 0x6000) {
+        return (cartridge->expansion != NULL) ? expansion_read(cartridge->expansion, address) : 0;
+    }
+    if (cartridge->prgRam != NULL) {
+        return cartridge->prgRam[address & 0x1FFF];
+    }
+    return 0;
+}
+
+/*
+    Mapper 3 (CNROM) switches the whole 8KB of CHR on any write to ROM
+    space. NSF rips switch each PRG window by writing its bank to one of
+    $5FF8-$5FFF. Sound chip registers go to the chips.
+*/
+void cartridge_cpuWrite(struct Cartridge *cartridge, uint16_t address, uint8_t data) {
+    if (cartridge->expansion != NULL && expansion_write(cartridge->expansion, address, data)) {
+        return;
+    }
+    if (address >= 0x8000) {
+        if (cartridge->mapper == 3) {
+            ppu_mapChr(cartridge->ppu, 0, 8, data & 0x03);
+        }
+    }
+    else if (address >= 0x6000) {
+        if (cartridge->prgRam != NULL) {
+            cartridge->prgRam[address & 0x1FFF] = data;
+        }
+    }
+    else if (address >= 0x5FF8 && cartridge->mapper == MAPPER_NSF) {
+        cartridge_mapPrg(cartridge, address & 7, data);
+    }
+}
@@ -0,0 +1,83 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "./headers/compose.h"
+
+
+/* ------------------
+    Scalar Reference
+    ----------------- */
+static void merge_scalar(uint8_t *indices, const uint8_t *background, const uint8_t *sprites, uint8_t mask) {
+    for (int x = 0; x < 256; x++) {
+        uint8_t b = background[x];
+        uint8_t s = sprites[x];
+        if (!(mask & 0x08) || (x < 8 && !(mask & 0x02))) {
+            b = 0;
+        }
+        if (!(mask & 0x10) || (x < 8 && !(mask & 0x04))) {
+            s = 0;
+        }
+
+        uint8_t index = (b & 0x03) ? (b & 0x0F) : 0;
+        if ((s & 0x03) && (!(s & 0x80) || !index)) {
+            index = s & 0x1F;
+        }
+        indices[x] = index;
+    }
+}
+
+void compose_paletteScalar(uint8_t *out, const uint8_t *indices, const uint8_t *palette, uint8_t greyscale) {
+    for (int x = 0; x < 256; x++) {
+        out[x] = palette[indices[x] & 0x1F] & greyscale;
+    }
+}
+
+const struct ComposeKernels compose_scalar = { "scalar", &merge_scalar, &compose_paletteScalar };
+
+
+/* ------------------
+    Backend Selection
+    ----------------- */
+const struct ComposeKernels *compose = &compose_scalar;
+
+static const struct ComposeKernels *available[5];
+
+/*
+    Lists the backends this CPU can run, fastest first and always ending
+    with the scalar reference
+*/
+const struct ComposeKernels **compose_available() {
+    int count = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        available[count++] = &compose_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        available[count++] = &compose_sse2;
+    }
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    available[count++] = &compose_neon;
+#endif
+    available[count++] = &compose_scalar;
+    available[count] = NULL;
+    return available;
+}
+
+void compose_init() {
+    compose = compose_available()[0];
+}
+
+/*
+    Forces a backend by name, returns 0 if it is not available here
+*/
+int compose_select(const char *name) {
+    for (const struct ComposeKernels **kernels = compose_available(); *kernels; kernels++) {
+        if (strcmp((*kernels)->name, name) == 0) {
+            compose = *kernels;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,16 @@
+#if defined(__x86_64__) || defined(__i386__)
+#pragma GCC target("avx2")
+
+#include <stdint.h>
+#include <string.h>
+
+#include "./headers/compose.h"
+
+#define SIMD_AVX2
+#define SIMD_NAME avx2
+#include "./headers/simd.h"
+#include "./headers/compose_kernels.h"
+
+const struct ComposeKernels compose_avx2 = { "avx2", &merge_avx2, &palette_avx2 };
+
+#endif
@@ -0,0 +1,15 @@
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <stdint.h>
+#include <string.h>
+
+#include "./headers/compose.h"
+
+#define SIMD_NEON
+#define SIMD_NAME neon
+#include "./headers/simd.h"
+#include "./headers/compose_kernels.h"
+
+const struct ComposeKernels compose_neon = { "neon", &merge_neon, &palette_neon };
+
+#endif
@@ -0,0 +1,19 @@
+#if defined(__x86_64__) || defined(__i386__)
+#pragma GCC target("sse2")
+
+#include <stdint.h>
+#include <string.h>
+
+#include "./headers/compose.h"
+
+#define SIMD_SSE2
+#define SIMD_NAME sse2
+#include "./headers/simd.h"
+#include "./headers/compose_kernels.h"
+
+/*
+    Without a byte shuffle the palette is looked up by the scalar kernel
+*/
+const struct ComposeKernels compose_sse2 = { "sse2", &merge_sse2, &compose_paletteScalar };
+
+#endif
@@ -0,0 +1,662 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "./headers/expansion.h"
+#include "./headers/apu.h"
+#include "./headers/blip.h"
+#include "./headers/scheduler.h"
+
+/*
+    Levels in the same units as the APU's mix. A VRC6 pulse at full
+    volume is about as loud as an APU pulse, a lone N163 channel playing a
+    full scale wave a little louder, and a 5B tone louder again.
+*/
+#define VRC6_UNIT 300
+#define N163_UNIT 40
+#define N163_SLOT 15
+#define SUNSOFT_PEAK 6000
+
+/*
+    The 5B's volumes are 1.5dB apart, 32 of them for the envelope and
+    every other one for a fixed volume
+*/
+static int sunsoftLevels[32];
+static int levelsReady = 0;
+
+static void buildLevels() {
+    for (int i = 1; i < 32; i++) {
+        sunsoftLevels[i] = (int)(SUNSOFT_PEAK * pow(10.0, (i - 31) * 1.5 / 20.0) + 0.5);
+    }
+    levelsReady = 1;
+}
+
+static uint64_t currentCycle(const struct Expansion *expansion) {
+    return expansion->apu->scheduler->now / CPU_DOTS;
+}
+
+/*
+    Moves a level to value at time, adding the step into the APU's buffer
+*/
+static void changeLevel(struct Expansion *expansion, uint64_t time, int *level, int value) {
+    if (value != *level) {
+        blip_addDelta(&expansion->apu->blip, (uint32_t)(time - expansion->apu->frameTime), value - *level);
+        *level = value;
+    }
+}
+
+/*
+    How many times a timer that next runs out at next, every length cycles,
+    runs out before time, moving next on past them
+*/
+static uint64_t runOuts(uint64_t *next, uint32_t length, uint64_t time) {
+    if (*next >= time) {
+        return 0;
+    }
+    uint64_t steps = (time - *next - 1) / length + 1;
+    *next += steps * length;
+    return steps;
+}
+
+
+/* -----
+    VRC6
+    ---- */
+
+/*
+    The frequency control register can divide every period by 16 or 256,
+    or halt all three timers
+*/
+static uint32_t vrc6Period(const struct VRC6 *vrc6, int channel) {
+    uint16_t period = (channel < 2) ? vrc6->pulse[channel].period : vrc6->saw.period;
+    return (period >> vrc6->shift) + 1;
+}
+
+static int vrc6Output(const struct VRC6 *vrc6, int channel) {
+    if (channel < 2) {
+        const struct VRC6Pulse *pulse = &vrc6->pulse[channel];
+        return (pulse->enabled && (pulse->mode || pulse->step <= pulse->duty)) ? pulse->volume : 0;
+    }
+    return vrc6->saw.enabled ? vrc6->saw.accumulator >> 3 : 0;
+}
+
+/*
+    A pulse in its constant volume mode never changes by itself. The
+    sawtooth's accumulator only moves on every other step of its timer.
+*/
+static int vrc6Active(const struct VRC6 *vrc6, int channel) {
+    if (vrc6->halt) {
+        return 0;
+    }
+    if (channel < 2) {
+        const struct VRC6Pulse *pulse = &vrc6->pulse[channel];
+        return pulse->enabled && !pulse->mode && pulse->volume;
+    }
+    return vrc6->saw.enabled && (vrc6->saw.rate || vrc6->saw.accumulator);
+}
+
+static uint32_t vrc6Run(const struct VRC6 *vrc6, int channel) {
+    if (channel < 2) {
+        const struct VRC6Pulse *pulse = &vrc6->pulse[channel];
+        return (pulse->step <= pulse->duty) ? pulse->step + 1 : pulse->step - pulse->duty;
+    }
+    return (vrc6->saw.step & 1) ? 1 : 2;
+}
+
+/*
+    A pulse counts its sixteen duty steps down. The sawtooth adds its rate
+    to the accumulator on every other of fourteen steps, and clears it on
+    the fourteenth, so where it ends up follows from where it started and
+    how many steps it took.
+*/
+static void vrc6Advance(struct VRC6 *vrc6, int channel, uint64_t time) {
+    uint64_t steps = runOuts(&vrc6->next[channel], vrc6Period(vrc6, channel), time);
+    if (!steps || vrc6->halt) {
+        return;
+    }
+    if (channel < 2) {
+        struct VRC6Pulse *pulse = &vrc6->pulse[channel];
+        if (pulse->enabled) {
+            pulse->step = (pulse->step - steps) & 15;
+        }
+        return;
+    }
+    struct VRC6Saw *saw = &vrc6->saw;
+    if (!saw->enabled) {
+        return;
+    }
+    uint32_t step = saw->step + (uint32_t)(steps % 14) + ((steps >= 14) ? 14 : 0);
+    if (step >= 14) {
+        step %= 14;
+        saw->accumulator = (uint8_t)(saw->rate * (step / 2));
+    }
+    else {
+        saw->accumulator += (uint8_t)(saw->rate * (step / 2 - saw->step / 2));
+    }
+    saw->step = (uint8_t)step;
+}
+
+static void vrc6Update(struct Expansion *expansion, int channel, uint64_t time) {
+    struct VRC6 *vrc6 = &expansion->vrc6;
+    vrc6->due[channel] = vrc6Active(vrc6, channel) ? vrc6->next[channel] + (uint64_t)(vrc6Run(vrc6, channel) - 1) * vrc6Period(vrc6, channel) : SCHEDULER_NEVER;
+    changeLevel(expansion, time, &vrc6->levels[channel], vrc6Output(vrc6, channel) * VRC6_UNIT);
+}
+
+/*
+    The channels are mixed by adding them, so each can be run to now on
+    its own
+*/
+static void vrc6CatchUp(struct Expansion *expansion, uint64_t now) {
+    struct VRC6 *vrc6 = &expansion->vrc6;
+    for (int channel = 0; channel < 3; channel++) {
+        while (vrc6->due[channel] < now) {
+            uint64_t time = vrc6->due[channel];
+            vrc6Advance(vrc6, channel, time + 1);
+            vrc6Update(expansion, channel, time);
+        }
+        vrc6Advance(vrc6, channel, now);
+    }
+}
+
+/*
+    $9000-$9002 and $A000-$A002 are the pulses, $B000-$B002 the sawtooth
+    and $9003 the frequency control
+*/
+static int vrc6Write(struct Expansion *expansion, uint16_t address, uint8_t data) {
+    int index = address & 0x0FFF;
+    if (address < 0x9000 || address >= 0xC000 || index > 3 || (index == 3 && address != 0x9003)) {
+        return 0;
+    }
+    struct VRC6 *vrc6 = &expansion->vrc6;
+    uint64_t now = currentCycle(expansion);
+    vrc6CatchUp(expansion, now);
+    int channel = (address >> 12) - 9;
+    if (index == 3) {
+        vrc6->halt = data & 1;
+        vrc6->shift = (data & 4) ? 8 : ((data & 2) ? 4 : 0);
+    }
+    else if (channel < 2) {
+        struct VRC6Pulse *pulse = &vrc6->pulse[channel];
+        switch (index) {
+            case 0:
+                pulse->mode = data >> 7;
+                pulse->duty = (data >> 4) & 7;
+                pulse->volume = data & 0x0F;
+                break;
+            case 1:
+                pulse->period = (pulse->period & 0x0F00) | data;
+                break;
+            case 2:
+                pulse->period = (pulse->period & 0x00FF) | ((uint16_t)(data & 0x0F) << 8);
+                pulse->enabled = data >> 7;
+                if (!pulse->enabled) {
+                    pulse->step = 15;
+                }
+                break;
+        }
+    }
+    else {
+        struct VRC6Saw *saw = &vrc6->saw;
+        switch (index) {
+            case 0:
+                saw->rate = data & 0x3F;
+                break;
+            case 1:
+                saw->period = (saw->period & 0x0F00) | data;
+                break;
+            case 2:
+                saw->period = (saw->period & 0x00FF) | ((uint16_t)(data & 0x0F) << 8);
+                saw->enabled = data >> 7;
+                if (!saw->enabled) {
+                    saw->step = 0;
+                    saw->accumulator = 0;
+                }
+                break;
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        vrc6Update(expansion, i, now);
+    }
+    return 1;
+}
+
+
+/* ---
+    5B
+    -- */
+static uint32_t sunsoftPeriod(const struct Sunsoft5B *sunsoft, int source) {
+    const uint8_t *registers = sunsoft->registers;
+    uint32_t period;
+    if (source < 3) {
+        period = registers[source * 2] | ((registers[source * 2 + 1] & 0x0F) << 8);
+        return (period ? period : 1) * 16;
+    }
+    if (source == 3) {
+        period = registers[6] & 0x1F;
+        return (period ? period : 1) * 32;
+    }
+    period = registers[11] | (registers[12] << 8);
+    return (period ? period : 1) * 16;
+}
+
+static int sunsoftAmplitude(const struct Sunsoft5B *sunsoft, int channel) {
+    uint8_t volume = sunsoft->registers[8 + channel];
+    if (volume & 0x10) {
+        return sunsoftLevels[sunsoft->envelopeAttack ? sunsoft->envelopeStep : 31 - sunsoft->envelopeStep];
+    }
+    return (volume & 0x0F) ? sunsoftLevels[(volume & 0x0F) * 2 + 1] : 0;
+}
+
+/*
+    A channel sounds while both its tone and the noise are high, either of
+    which the mixer can take out by holding it high
+*/
+static int sunsoftOutput(const struct Sunsoft5B *sunsoft) {
+    uint8_t mixer = sunsoft->registers[7];
+    int total = 0;
+    for (int channel = 0; channel < 3; channel++) {
+        int tone = sunsoft->tone[channel] | ((mixer >> channel) & 1);
+        int noise = (sunsoft->noise & 1) | ((mixer >> (channel + 3)) & 1);
+        if (tone && noise) {
+            total += sunsoftAmplitude(sunsoft, channel);
+        }
+    }
+    return total;
+}
+
+static int sunsoftActive(const struct Sunsoft5B *sunsoft, int source) {
+    uint8_t mixer = sunsoft->registers[7];
+    if (source < 3) {
+        return !((mixer >> source) & 1) && sunsoftAmplitude(sunsoft, source);
+    }
+    for (int channel = 0; channel < 3; channel++) {
+        if (source == 3 && !((mixer >> (channel + 3)) & 1) && sunsoftAmplitude(sunsoft, channel)) {
+            return 1;
+        }
+        if (source == 4 && !sunsoft->envelopeHolding && (sunsoft->registers[8 + channel] & 0x10)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+    The envelope ramps over 32 steps and then, by its shape, drops to
+    nothing and holds, holds where it is or the other end, or ramps again
+    the same way or back
+*/
+static void stepEnvelope(struct Sunsoft5B *sunsoft) {
+    if (sunsoft->envelopeHolding || ++sunsoft->envelopeStep < 32) {
+        return;
+    }
+    uint8_t shape = sunsoft->registers[13];
+    sunsoft->envelopeStep = 31;
+    if (!(shape & 0x08)) {
+        sunsoft->envelopeHolding = 1;
+        sunsoft->envelopeAttack = 0;
+        return;
+    }
+    sunsoft->envelopeAttack ^= (shape >> 1) & 1;
+    if (shape & 0x01) {
+        sunsoft->envelopeHolding = 1;
+    }
+    else {
+        sunsoft->envelopeStep = 0;
+    }
+}
+
+static void clockSunsoftNoise(struct Sunsoft5B *sunsoft) {
+    uint32_t feedback = (sunsoft->noise ^ (sunsoft->noise >> 3)) & 1;
+    sunsoft->noise = (sunsoft->noise >> 1) | (feedback << 16);
+}
+
+/*
+    The noise is a 17 bit linear shift register, jumped the way the APU's
+    is: sunsoftJumps[k] holds the columns of its matrix for 2^k clocks.
+    The count's low bits are clocked and the rest jumped, so even a whole
+    131070 clock advance is at most 7 clocks and 14 jumps.
+*/
+#define SUNSOFT_CLOCKED 8
+
+static uint32_t sunsoftJumps[17][17];
+static int sunsoftJumpsReady = 0;
+
+static uint32_t jumpSunsoftNoise(const uint32_t *columns, uint32_t noise) {
+    uint32_t result = 0;
+    for (int bit = 0; bit < 17; bit++) {
+        result ^= columns[bit] & -((noise >> bit) & 1);
+    }
+    return result;
+}
+
+static void buildSunsoftJumps() {
+    for (int bit = 0; bit < 17; bit++) {
+        struct Sunsoft5B sunsoft = { .noise = 1u << bit };
+        clockSunsoftNoise(&sunsoft);
+        sunsoftJumps[0][bit] = sunsoft.noise;
+    }
+    for (int k = 1; k < 17; k++) {
+        for (int bit = 0; bit < 17; bit++) {
+            sunsoftJumps[k][bit] = jumpSunsoftNoise(sunsoftJumps[k - 1], sunsoftJumps[k - 1][bit]);
+        }
+    }
+    sunsoftJumpsReady = 1;
+}
+
+/*
+    Tones only flip. The noise comes round again every 131071 steps, and
+    an envelope that keeps ramping every 64, while one that holds does so
+    within 32.
+*/
+static void sunsoftAdvance(struct Sunsoft5B *sunsoft, int source, uint64_t time) {
+    uint64_t steps = runOuts(&sunsoft->next[source], sunsoftPeriod(sunsoft, source), time);
+    if (!steps) {
+        return;
+    }
+    if (source < 3) {
+        sunsoft->tone[source] ^= steps & 1;
+    }
+    else if (source == 3) {
+        uint32_t count = (uint32_t)(steps % 131071);
+        for (uint32_t i = 0; i < (count & (SUNSOFT_CLOCKED - 1)); i++) {
+            clockSunsoftNoise(sunsoft);
+        }
+        count /= SUNSOFT_CLOCKED;
+        for (int k = __builtin_ctz(SUNSOFT_CLOCKED); count != 0; k++, count >>= 1) {
+            if (count & 1) {
+                sunsoft->noise = jumpSunsoftNoise(sunsoftJumps[k], sunsoft->noise);
+            }
+        }
+    }
+    else if (!sunsoft->envelopeHolding) {
+        uint32_t count = ((sunsoft->registers[13] & 0x09) == 0x08) ? (uint32_t)(steps % 64) : (uint32_t)((steps < 32) ? steps : 32);
+        for (uint32_t i = 0; i < count; i++) {
+            stepEnvelope(sunsoft);
+        }
+    }
+}
+
+static void sunsoftSettle(struct Sunsoft5B *sunsoft, uint64_t time) {
+    for (int source = 0; source < 5; source++) {
+        sunsoftAdvance(sunsoft, source, time);
+    }
+}
+
+static void sunsoftRefresh(struct Expansion *expansion, uint64_t time) {
+    struct Sunsoft5B *sunsoft = &expansion->sunsoft;
+    for (int source = 0; source < 5; source++) {
+        sunsoft->due[source] = sunsoftActive(sunsoft, source) ? sunsoft->next[source] : SCHEDULER_NEVER;
+    }
+    changeLevel(expansion, time, &sunsoft->level, sunsoftOutput(sunsoft));
+}
+
+/*
+    The tones share the noise and the envelope, so everything is brought
+    up to each change together
+*/
+static void sunsoftCatchUp(struct Expansion *expansion, uint64_t now) {
+    struct Sunsoft5B *sunsoft = &expansion->sunsoft;
+    for (;;) {
+        uint64_t earliest = SCHEDULER_NEVER;
+        for (int source = 0; source < 5; source++) {
+            if (sunsoft->due[source] < earliest) {
+                earliest = sunsoft->due[source];
+            }
+        }
+        if (earliest >= now) {
+            break;
+        }
+        sunsoftSettle(sunsoft, earliest + 1);
+        sunsoftRefresh(expansion, earliest);
+    }
+    sunsoftSettle(sunsoft, now);
+}
+
+/*
+    $C000 picks a register and $E000 writes it. Writing the shape starts
+    the envelope over.
+*/
+static int sunsoftWrite(struct Expansion *expansion, uint16_t address, uint8_t data) {
+    struct Sunsoft5B *sunsoft = &expansion->sunsoft;
+    if (address == 0xC000) {
+        sunsoft->address = data & 0x0F;
+        return 1;
+    }
+    if (address != 0xE000) {
+        return 0;
+    }
+    uint64_t now = currentCycle(expansion);
+    sunsoftCatchUp(expansion, now);
+    sunsoft->registers[sunsoft->address] = data;
+    if (sunsoft->address == 13) {
+        sunsoft->envelopeStep = 0;
+        sunsoft->envelopeAttack = (data >> 2) & 1;
+        sunsoft->envelopeHolding = 0;
+    }
+    sunsoftRefresh(expansion, now);
+    return 1;
+}
+
+
+/* -----
+    N163
+    ---- */
+static int namcoCount(const struct Namco163 *namco) {
+    return ((namco->ram[0x7F] >> 4) & 7) + 1;
+}
+
+/*
+    Only the last channels play, as many as the count in $7F asks for
+*/
+static int namcoEnabled(const struct Namco163 *namco, int channel) {
+    return channel >= N163_CHANNELS - namcoCount(namco);
+}
+
+static uint32_t namcoFrequency(const struct Namco163 *namco, int channel) {
+    const uint8_t *registers = namco->ram + 0x40 + channel * 8;
+    return registers[0] | (registers[2] << 8) | ((registers[4] & 0x03) << 16);
+}
+
+static uint32_t namcoPhase(const struct Namco163 *namco, int channel) {
+    const uint8_t *registers = namco->ram + 0x40 + channel * 8;
+    return registers[1] | (registers[3] << 8) | ((uint32_t)registers[5] << 16);
+}
+
+static void setNamcoPhase(struct Namco163 *namco, int channel, uint32_t phase) {
+    uint8_t *registers = namco->ram + 0x40 + channel * 8;
+    registers[1] = phase & 0xFF;
+    registers[3] = (phase >> 8) & 0xFF;
+    registers[5] = (phase >> 16) & 0xFF;
+}
+
+/*
+    The wave's length in samples, in the same 8.16 fixed point as the
+    phase: a sample index over a 16 bit fraction
+*/
+static uint32_t namcoLength(const struct Namco163 *namco, int channel) {
+    return (uint32_t)(256 - (namco->ram[0x40 + channel * 8 + 4] & 0xFC)) << 16;
+}
+
+static uint8_t namcoVolume(const struct Namco163 *namco, int channel) {
+    return namco->ram[0x40 + channel * 8 + 7] & 0x0F;
+}
+
+/*
+    Samples are packed two to a byte, low nibble first, from the channel's
+    wave address
+*/
+static int namcoOutput(const struct Namco163 *namco, int channel) {
+    if (!namcoEnabled(namco, channel)) {
+        return 0;
+    }
+    uint8_t index = namco->ram[0x40 + channel * 8 + 6] + (namcoPhase(namco, channel) >> 16);
+    int sample = (namco->ram[index >> 1] >> ((index & 1) * 4)) & 0x0F;
+    return (sample - 8) * namcoVolume(namco, channel);
+}
+
+static uint32_t namcoRound(const struct Namco163 *namco) {
+    return N163_SLOT * namcoCount(namco);
+}
+
+/*
+    A channel is only updated once a round, adding its frequency to its
+    phase, so any number of rounds are one multiply
+*/
+static void namcoAdvance(struct Namco163 *namco, int channel, uint64_t time) {
+    uint64_t rounds = runOuts(&namco->next[channel], namcoRound(namco), time);
+    if (!rounds || !namcoEnabled(namco, channel)) {
+        return;
+    }
+    uint64_t phase = namcoPhase(namco, channel) + rounds * namcoFrequency(namco, channel);
+    setNamcoPhase(namco, channel, (uint32_t)(phase % namcoLength(namco, channel)));
+}
+
+/*
+    The round the phase reaches the next sample on, which is the first
+    chance its output has to change
+*/
+static uint64_t namcoDue(const struct Namco163 *namco, int channel) {
+    uint32_t frequency = namcoFrequency(namco, channel);
+    if (!namcoEnabled(namco, channel) || !frequency || !namcoVolume(namco, channel)) {
+        return SCHEDULER_NEVER;
+    }
+    uint32_t phase = namcoPhase(namco, channel);
+    uint64_t rounds = 1;
+    if (phase < namcoLength(namco, channel)) {
+        uint32_t distance = (((phase >> 16) + 1) << 16) - phase;
+        rounds = (distance + frequency - 1) / frequency;
+    }
+    return namco->next[channel] + (rounds - 1) * namcoRound(namco);
+}
+
+/*
+    The chip plays each channel in turn for a slot. That switching is
+    well above what is heard, so each channel is mixed in as its share of
+    every round, which is all the ear makes of it.
+*/
+static void namcoUpdate(struct Expansion *expansion, int channel, uint64_t time) {
+    struct Namco163 *namco = &expansion->namco;
+    namco->due[channel] = namcoDue(namco, channel);
+    changeLevel(expansion, time, &namco->levels[channel], namcoOutput(namco, channel) * N163_UNIT / namcoCount(namco));
+}
+
+static void namcoCatchUp(struct Expansion *expansion, uint64_t now) {
+    struct Namco163 *namco = &expansion->namco;
+    for (int channel = 0; channel < N163_CHANNELS; channel++) {
+        while (namco->due[channel] < now) {
+            uint64_t time = namco->due[channel];
+            namcoAdvance(namco, channel, time + 1);
+            namcoUpdate(expansion, channel, time);
+        }
+        namcoAdvance(namco, channel, now);
+    }
+}
+
+/*
+    $F800 sets the RAM address, with the top bit asking for it to move on
+    after each access through $4800
+*/
+static int namcoWrite(struct Expansion *expansion, uint16_t address, uint8_t data) {
+    struct Namco163 *namco = &expansion->namco;
+    if (address >= 0xF800) {
+        namco->address = data & 0x7F;
+        namco->increment = data >> 7;
+        return 1;
+    }
+    if (address < 0x4800 || address >= 0x5000) {
+        return 0;
+    }
+    uint64_t now = currentCycle(expansion);
+    namcoCatchUp(expansion, now);
+    namco->ram[namco->address] = data;
+    namco->address = (namco->address + namco->increment) & 0x7F;
+    for (int channel = 0; channel < N163_CHANNELS; channel++) {
+        namcoUpdate(expansion, channel, now);
+    }
+    return 1;
+}
+
+
+/* -----------
+    Interface
+    ---------- */
+
+/*
+    Attaches the chips to the APU's output, all of them silent. Chips not
+    in EXPANSION_CHIPS are ignored.
+*/
+void expansion_init(struct Expansion *expansion, struct APU *apu, uint8_t chips) {
+    if (!levelsReady) {
+        buildLevels();
+    }
+    if (!sunsoftJumpsReady) {
+        buildSunsoftJumps();
+    }
+    memset(expansion, 0, sizeof(struct Expansion));
+    expansion->apu = apu;
+    expansion->chips = chips & EXPANSION_CHIPS;
+    apu->expansion = expansion;
+
+    uint64_t time = apu->time;
+    struct VRC6 *vrc6 = &expansion->vrc6;
+    vrc6->pulse[0].step = 15;
+    vrc6->pulse[1].step = 15;
+    for (int channel = 0; channel < 3; channel++) {
+        vrc6->next[channel] = time + vrc6Period(vrc6, channel);
+        vrc6->due[channel] = SCHEDULER_NEVER;
+    }
+    struct Sunsoft5B *sunsoft = &expansion->sunsoft;
+    sunsoft->noise = 1;
+    for (int source = 0; source < 5; source++) {
+        sunsoft->next[source] = time + sunsoftPeriod(sunsoft, source);
+        sunsoft->due[source] = SCHEDULER_NEVER;
+    }
+    struct Namco163 *namco = &expansion->namco;
+    for (int channel = 0; channel < N163_CHANNELS; channel++) {
+        namco->next[channel] = time + namcoRound(namco);
+        namco->due[channel] = SCHEDULER_NEVER;
+    }
+}
+
+/*
+    Returns whether the write was to one of the chips
+*/
+int expansion_write(struct Expansion *expansion, uint16_t address, uint8_t data) {
+    if ((expansion->chips & EXPANSION_VRC6) && vrc6Write(expansion, address, data)) {
+        return 1;
+    }
+    if ((expansion->chips & EXPANSION_5B) && sunsoftWrite(expansion, address, data)) {
+        return 1;
+    }
+    return (expansion->chips & EXPANSION_N163) && namcoWrite(expansion, address, data);
+}
+
+/*
+    Only the N163's RAM can be read back, phases included
+*/
+uint8_t expansion_read(struct Expansion *expansion, uint16_t address) {
+    struct Namco163 *namco = &expansion->namco;
+    if (!(expansion->chips & EXPANSION_N163) || address < 0x4800 || address >= 0x5000) {
+        return 0;
+    }
+    namcoCatchUp(expansion, currentCycle(expansion));
+    uint8_t data = namco->ram[namco->address];
+    namco->address = (namco->address + namco->increment) & 0x7F;
+    return data;
+}
+
+/*
+    Runs the chips up to the CPU cycle the scheduler is on
+*/
+void expansion_catchUp(struct Expansion *expansion) {
+    uint64_t now = currentCycle(expansion);
+    if (expansion->chips & EXPANSION_VRC6) {
+        vrc6CatchUp(expansion, now);
+    }
+    if (expansion->chips & EXPANSION_5B) {
+        sunsoftCatchUp(expansion, now);
+    }
+    if (expansion->chips & EXPANSION_N163) {
+        namcoCatchUp(expansion, now);
+    }
+}
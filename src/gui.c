@@ -1,11 +1,28 @@
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
-#include "./../lib/SDL/SDL/include/SDL2/SDL.h"
+#include "./headers/gui.h"
+#include "./headers/output.h"
+#include "./headers/scale.h"
+#include "./headers/audiosink.h"
+#include "./headers/ratecontrol.h"
 
-#define SDL_MAIN_HANDLED
 #define Width 256
 #define Height 240
 #define Scale 3
+#define FrameRate 60.0988
+#define PaceLimit 17
+
+static struct Output output;
+static struct Scaler scaler;
+static uint8_t line[Width * 4];
+static SDL_Renderer *renderer = NULL;
+static SDL_Texture *texture = NULL;
+static SDL_AudioDeviceID audio = 0;
+static int audioRate = 0;
+static unsigned paceTimeouts = 0;
+static struct AudioRing ring;
 
 
 /*
@@ -40,6 +57,252 @@ void GUI_stopSDL() {
     SDL_Quit(); 
 }
 
+int GUI_pollQuit() {
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/*
+    Frame Output
+
+    By default frames go to the window surface in whatever format SDL gave
+    it. In RGB565 mode a 16 bit streaming texture is requested instead, so
+    the tables, the scaler and the texture upload all move half the bytes.
+
+    Asking for vsync also goes through a texture, 32 bit unless RGB565 was
+    asked for, presented on a renderer that waits for the display. That is
+    only worth doing when the display refreshes close enough to the NES's
+    frame rate for rate control to make up the difference. SDL reports
+    59.94 Hz modes as 59.
+*/
+static int refreshMatches(SDL_Window *window) {
+    SDL_DisplayMode mode;
+    if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &mode) != 0 || mode.refresh_rate == 0) {
+        return 0;
+    }
+    double refresh = (mode.refresh_rate == 59) ? 59.94 : mode.refresh_rate;
+    return fabs(refresh / FrameRate - 1.0) <= RATE_MAX_DELTA;
+}
+
+/*
+    Returns 1 if presenting a frame now waits for vsync
+*/
+int GUI_initialiseOutput(SDL_Window *window, int rgb565, int vsync) {
+    vsync = vsync && refreshMatches(window);
+    if (rgb565 || vsync) {
+        renderer = SDL_CreateRenderer(window, -1, vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+        Uint32 format = rgb565 ? SDL_PIXELFORMAT_RGB565 : SDL_PIXELFORMAT_ARGB8888;
+        texture = (renderer == NULL) ? NULL : SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, Width * Scale, Height * Scale);
+        if (texture == NULL) {
+            printf("%s\n", SDL_GetError());
+            exit(1);
+        }
+        if (rgb565) {
+            output_init(&output, 2, 0xF800, 0x07E0, 0x001F, 0);
+        }
+        else {
+            output_init(&output, 4, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+        }
+        SDL_RendererInfo info;
+        vsync = vsync && SDL_GetRendererInfo(renderer, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC);
+    }
+    else {
+        SDL_PixelFormat *format = SDL_GetWindowSurface(window)->format;
+        if (!output_init(&output, format->BytesPerPixel, format->Rmask, format->Gmask, format->Bmask, format->Amask)) {
+            printf("Unsupported window format %s\n", SDL_GetPixelFormatName(format->format));
+            exit(1);
+        }
+    }
+    scale_init(&scaler, output.bytesPerPixel, Scale);
+    return vsync;
+}
+
+void GUI_closeOutput() {
+    if (texture != NULL) {
+        SDL_DestroyTexture(texture);
+        texture = NULL;
+    }
+    if (renderer != NULL) {
+        SDL_DestroyRenderer(renderer);
+        renderer = NULL;
+    }
+}
+
+/*
+    Converts each line of PPU colours into the native format while it is
+    small enough to sit in L1, widens it straight into the locked pixels and
+    copies that line down for the rest of the scale factor
+*/
+static void drawFrame(uint8_t *pixels, int pitch, const uint8_t *colours, const uint8_t *emphasis) {
+    for (int y = 0; y < Height; y++) {
+        uint8_t *out = pixels + y * Scale * pitch;
+        output.convertRow(&output, line, colours + y * Width, emphasis[y]);
+        scaler.row(out, line, Width);
+        scale_duplicate(&scaler, out, pitch, Width);
+    }
+}
+
+void GUI_presentFrame(SDL_Window *window, const uint8_t *colours, const uint8_t *emphasis) {
+    if (texture != NULL) {
+        void *pixels;
+        int pitch;
+        SDL_LockTexture(texture, NULL, &pixels, &pitch);
+        drawFrame(pixels, pitch, colours, emphasis);
+        SDL_UnlockTexture(texture);
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        SDL_RenderPresent(renderer);
+        return;
+    }
+    SDL_Surface *surface = SDL_GetWindowSurface(window);
+    SDL_LockSurface(surface);
+    drawFrame(surface->pixels, surface->pitch, colours, emphasis);
+    SDL_UnlockSurface(surface);
+    SDL_UpdateWindowSurface(window);
+}
+
+/*
+    Audio
+
+    SDL's callback pulls samples out of a lock free ring the emulator
+    pushes each frame's samples into, so neither thread ever waits on the
+    other. Without vsync to pace it, the emulator sleeps while more than
+    target samples are still waiting to be played, but never for more than
+    PaceLimit ms: a device that has stopped pulling, unplugged or paused by
+    the system, must not stop the window being closed.
+*/
+static void pullAudio(void *context, Uint8 *stream, int length) {
+    audioring_read(context, (int16_t *)stream, length / (int)sizeof(int16_t));
+}
+
+int GUI_openAudio(int rate) {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+        printf("%s\n", SDL_GetError());
+        return 0;
+    }
+    audioring_init(&ring);
+    paceTimeouts = 0;
+    SDL_AudioSpec wanted;
+    SDL_AudioSpec obtained;
+    SDL_zero(wanted);
+    wanted.freq = rate;
+    wanted.format = AUDIO_S16SYS;
+    wanted.channels = 1;
+    wanted.samples = 1024;
+    wanted.callback = &pullAudio;
+    wanted.userdata = &ring;
+    audio = SDL_OpenAudioDevice(NULL, 0, &wanted, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (audio == 0) {
+        printf("%s\n", SDL_GetError());
+        return 0;
+    }
+    audioRate = obtained.freq;
+    return audioRate;
+}
+
+/*
+    The device is left paused until the first samples arrive, so it doesn't
+    start out underrunning while the first frame is emulated
+*/
+void GUI_writeAudio(const int16_t *samples, int count) {
+    if (audio == 0) {
+        return;
+    }
+    audioring_write(&ring, samples, count);
+    if (SDL_GetAudioDeviceStatus(audio) == SDL_AUDIO_PAUSED) {
+        SDL_PauseAudioDevice(audio, 0);
+    }
+}
+
+void GUI_paceAudio(unsigned target) {
+    if (audio == 0) {
+        return;
+    }
+    Uint32 start = SDL_GetTicks();
+    while (audioring_fill(&ring) > target) {
+        if (SDL_GetTicks() - start >= PaceLimit) {
+            paceTimeouts++;
+            return;
+        }
+        SDL_Delay(1);
+    }
+}
+
+/*
+    Underruns, overruns and pacing timeouts since the device was opened,
+    and how full the ring is now
+*/
+void GUI_audioStats(struct AudioStats *stats) {
+    audioring_stats(&ring, stats);
+    stats->paceTimeouts = paceTimeouts;
+}
+
+int GUI_closeAudio() {
+    if (audio != 0) {
+        SDL_CloseAudioDevice(audio);
+        audio = 0;
+    }
+    return 1;
+}
+
+const struct AudioSink GUI_audioSink = { "sdl", 1, &GUI_openAudio, &GUI_writeAudio, &GUI_paceAudio, &GUI_audioStats, &GUI_closeAudio };
+
+/*
+    Times the scaler alone, widening and copying down an already converted
+    frame into memory, returning the seconds a frame took
+*/
+static double timeScaler(const uint8_t *colours, const uint8_t *emphasis, int frames) {
+    int pitch = Width * Scale * output.bytesPerPixel;
+    uint8_t *converted = malloc(Width * Height * output.bytesPerPixel);
+    uint8_t *scaled = malloc((size_t)pitch * Height * Scale);
+    double seconds = 0.0;
+    if (converted != NULL && scaled != NULL) {
+        output_convertFrame(&output, converted, Width * output.bytesPerPixel, colours, emphasis);
+        uint64_t start = SDL_GetPerformanceCounter();
+        for (int frame = 0; frame < frames; frame++) {
+            for (int y = 0; y < Height; y++) {
+                uint8_t *out = scaled + y * Scale * pitch;
+                scaler.row(out, converted + y * Width * output.bytesPerPixel, Width);
+                scale_duplicate(&scaler, out, pitch, Width);
+            }
+        }
+        seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency() / frames;
+    }
+    free(converted);
+    free(scaled);
+    return seconds;
+}
+
+/*
+    Times convert, scale and present of the same frame in both output
+    modes, each in a fresh window, then the scaler on its own
+*/
+void GUI_benchmarkPresent(const uint8_t *colours, const uint8_t *emphasis, int frames) {
+    const char *modes[2] = { "window surface", "rgb565 texture" };
+    for (int rgb565 = 0; rgb565 < 2; rgb565++) {
+        SDL_Window *window = GUI_initialiseWindow();
+        GUI_initialiseOutput(window, rgb565, 0);
+        GUI_presentFrame(window, colours, emphasis);
+
+        uint64_t start = SDL_GetPerformanceCounter();
+        for (int frame = 0; frame < frames; frame++) {
+            GUI_presentFrame(window, colours, emphasis);
+            GUI_pollQuit();
+        }
+        double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+        printf("%s (%s, %s scaler): %.3f ms per frame, %d bytes per frame\n", modes[rgb565], output.name, scaler.name, seconds * 1000.0 / frames, Width * Height * Scale * Scale * output.bytesPerPixel);
+        printf("  %s scaler alone: %.3f ms per frame\n", scaler.name, timeScaler(colours, emphasis, frames) * 1000.0);
+
+        GUI_closeOutput();
+        GUI_closeWindow(window);
+    }
+}
+
 
 /*
 
@@ -0,0 +1,137 @@
+#ifndef APU_H
+#define APU_H
+
+#include <stdint.h>
+
+#include "./blip.h"
+#include "./scheduler.h"
+
+#define APU_CLOCK_RATE 1789773.0
+#define APU_CHANNELS 5
+#define DMC_STALL 4
+#define DMC_STALL_OAM 2
+
+struct Expansion;
+
+enum Channel {
+    CHANNEL_PULSE1,
+    CHANNEL_PULSE2,
+    CHANNEL_TRIANGLE,
+    CHANNEL_NOISE,
+    CHANNEL_DMC
+};
+
+struct Envelope {
+    uint8_t start;
+    uint8_t loop;
+    uint8_t constant;
+    uint8_t period;
+    uint8_t divider;
+    uint8_t decay;
+};
+
+struct Pulse {
+    struct Envelope envelope;
+    uint8_t duty;
+    uint8_t phase;
+    uint8_t length;
+    uint16_t timer;
+    uint8_t sweepEnabled;
+    uint8_t sweepPeriod;
+    uint8_t sweepNegate;
+    uint8_t sweepShift;
+    uint8_t sweepDivider;
+    uint8_t sweepReload;
+};
+
+struct Triangle {
+    uint8_t control;
+    uint8_t linearReload;
+    uint8_t linear;
+    uint8_t linearStart;
+    uint8_t phase;
+    uint8_t length;
+    uint16_t timer;
+};
+
+struct Noise {
+    struct Envelope envelope;
+    uint8_t mode;
+    uint8_t period;
+    uint8_t length;
+    uint16_t shift;
+};
+
+struct DMC {
+    uint8_t irqEnabled;
+    uint8_t loop;
+    uint8_t rate;
+    uint8_t level;
+    uint16_t start;
+    uint16_t length;
+    uint16_t address;
+    uint16_t remaining;
+    uint8_t buffer;
+    uint8_t bufferFull;
+    uint8_t shift;
+    uint8_t bits;
+    uint8_t silent;
+};
+
+/*
+    The APU is stepped from one change of output to the next rather than
+    clock by clock, and only when something needs it: a register access,
+    the end of a frame's samples, or a scheduler event on the cycle after
+    an interrupt could be raised or the DMC fetches a byte. Fetches read
+    PRG through the cartridge's windows and add the cycles they steal
+    from the CPU to stall. Each channel keeps the CPU cycle its timer
+    next runs out on and the cycle its output can next change on, the
+    earliest of those and the frame counter's next step is the only thing
+    done next, and the mixed level is handed to the step buffer only when
+    it moves. Sound chips on the cartridge, if there are any, add their
+    own steps to the same buffer.
+*/
+struct APU {
+    struct Scheduler *scheduler;
+    uint64_t time;
+    uint64_t frameTime;
+    uint64_t next[APU_CHANNELS];
+    uint64_t due[APU_CHANNELS];
+    uint8_t outputs[APU_CHANNELS];
+    int level;
+
+    struct Pulse pulse[2];
+    struct Triangle triangle;
+    struct Noise noise;
+    struct DMC dmc;
+    uint8_t enabled;
+
+    uint8_t fiveStep;
+    uint8_t irqInhibit;
+    uint8_t frameStep;
+    uint64_t frameNext;
+    uint8_t frameInterrupt;
+    uint8_t dmcInterrupt;
+
+    uint8_t *const *prg;
+    int *stall;
+    uint64_t oamDmaEnd;
+
+    struct Blip blip;
+    struct Expansion *expansion;
+};
+
+void apu_init(struct APU *apu, struct Scheduler *scheduler, int sampleRate);
+void apu_connect(struct APU *apu, uint8_t *const *prg, int *stall);
+void apu_oamDma(struct APU *apu, int cycles);
+void apu_catchUp(struct APU *apu);
+void apu_writeRegister(struct APU *apu, uint16_t address, uint8_t data);
+uint8_t apu_readStatus(struct APU *apu);
+void apu_endFrame(struct APU *apu);
+void apu_setSampleRate(struct APU *apu, double sampleRate);
+int apu_readSamples(struct APU *apu, int16_t *out, int count);
+
+static inline int apu_irq(const struct APU *apu) {
+    return apu->frameInterrupt || apu->dmcInterrupt;
+}
+#endif
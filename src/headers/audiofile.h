@@ -0,0 +1,15 @@
+#ifndef AUDIOFILE_H
+#define AUDIOFILE_H
+
+#include <stdint.h>
+
+#include "./audiosink.h"
+
+#define AUDIO_FILE_BUFFER 65536
+
+extern const struct AudioSink audiofile_sink;
+
+void audiofile_setPath(const char *path);
+uint32_t audiofile_hash();
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef AUDIORING_H
+#define AUDIORING_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define AUDIO_RING_SIZE 8192
+
+/*
+    Carries samples from the emulation thread to the audio callback without
+    a lock. Positions only ever count up and are masked when used, so full
+    and empty can't be confused. Each counter is written by one side only,
+    the producer publishing samples with a release store of head and the
+    consumer handing space back with one of tail.
+
+    Neither side waits. A write that doesn't fit drops what is left over
+    and counts an overrun. A read that comes up short repeats the last
+    sample for the rest and counts an underrun.
+*/
+struct AudioRing {
+    int16_t samples[AUDIO_RING_SIZE];
+    atomic_uint head;
+    atomic_uint tail;
+    atomic_uint underruns;
+    atomic_uint overruns;
+    int16_t last;
+};
+
+/*
+    paceTimeouts counts the waits a sink's pace gave up on because the
+    samples stopped draining, the ring leaves it to the sink
+*/
+struct AudioStats {
+    unsigned fill;
+    unsigned underruns;
+    unsigned overruns;
+    unsigned paceTimeouts;
+};
+
+void audioring_init(struct AudioRing *ring);
+int audioring_write(struct AudioRing *ring, const int16_t *samples, int count);
+void audioring_read(struct AudioRing *ring, int16_t *out, int count);
+void audioring_stats(struct AudioRing *ring, struct AudioStats *stats);
+
+/*
+    Samples waiting to be played, as far as the producer can tell
+*/
+static inline unsigned audioring_fill(struct AudioRing *ring) {
+    return atomic_load_explicit(&ring->head, memory_order_relaxed) - atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef AUDIOSINK_H
+#define AUDIOSINK_H
+
+#include <stdint.h>
+
+#include "./audioring.h"
+
+/*
+    Somewhere finished samples go. open returns the sample rate it settled
+    on, or 0 if it can't be used. A realtime sink plays samples as they
+    are due, so the emulator's rate control and pacing steer by it. pace
+    waits until no more than target samples are left queued, or for about
+    a frame at most in case nothing is playing them. close returns 0 if
+    any of the samples could not be delivered.
+*/
+struct AudioSink {
+    const char *name;
+    int realtime;
+    int (*open)(int rate);
+    void (*write)(const int16_t *samples, int count);
+    void (*pace)(unsigned target);
+    void (*stats)(struct AudioStats *stats);
+    int (*close)();
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef BGLAYER_H
+#define BGLAYER_H
+
+#include <stdint.h>
+
+#include "./ppu.h"
+
+#define LAYER_WIDTH 512
+#define LAYER_HEIGHT 480
+#define LAYER_COLUMNS 64
+#define LAYER_ROWS 60
+
+/*
+    All four nametables drawn out as one bitmap, in the same palette << 2 |
+    pattern form as the scanline renderer's background line. A line of
+    background is then a copy from the scroll position. Tiles are drawn
+    again only once something they are made from has changed, one dirty
+    bit per tile and one per pattern written in CHR RAM.
+*/
+struct BackgroundLayer {
+    uint8_t pixels[LAYER_HEIGHT][LAYER_WIDTH];
+    uint64_t dirty[LAYER_ROWS];
+    uint64_t patterns[8];
+    int patternsDirty;
+};
+
+struct BackgroundLayer *bglayer_create(void);
+void bglayer_markAll(struct BackgroundLayer *layer);
+void bglayer_markWrite(struct BackgroundLayer *layer, const struct PPU *ppu, uint16_t address);
+void bglayer_markPattern(struct BackgroundLayer *layer, uint16_t address);
+int bglayer_fetchLine(struct BackgroundLayer *layer, const struct PPU *ppu, uint16_t v, uint8_t *line);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef BLIP_H
+#define BLIP_H
+
+#include <stdint.h>
+
+#define BLIP_SIZE 4096
+#define BLIP_TAPS 16
+#define BLIP_PHASES 32
+
+/*
+    A band-limited step buffer. Sound is described only by the times its
+    level changes and by how much, each change adding a windowed sinc step
+    at its exact fractional sample position into a buffer of differences.
+    Reading runs the buffer through an integrator, so a sample costs one
+    add however many clocks it spans.
+
+    Times are in clocks since the last blip_endFrame. offset is the sample
+    position of the frame start in 32.32 fixed point, its whole part the
+    samples already finished and waiting to be read.
+*/
+struct Blip {
+    int32_t buffer[BLIP_SIZE + BLIP_TAPS];
+    uint64_t factor;
+    uint64_t offset;
+    int32_t integrator;
+};
+
+/*
+    Adds a step's taps, scaled by its height, into the buffer at its first
+    sample. This is the polyphase filter's whole inner loop. The vector
+    backends take heights that fit in 16 bits and give exactly the scalar
+    sums. Without -O the compiler leaves the scalar loop as it is, so they
+    matter most to the plain make build.
+*/
+struct BlipKernels {
+    const char *name;
+    void (*addStep)(int32_t *out, const int16_t *taps, int delta);
+};
+
+extern const struct BlipKernels blip_scalar;
+extern const struct BlipKernels blip_sse2;
+extern const struct BlipKernels blip_neon;
+
+extern const struct BlipKernels *blip_kernels;
+
+const struct BlipKernels **blip_kernelsAvailable();
+int blip_selectKernels(const char *name);
+
+void blip_init(struct Blip *blip, double clockRate, double sampleRate);
+void blip_setRates(struct Blip *blip, double clockRate, double sampleRate);
+void blip_addDelta(struct Blip *blip, uint32_t time, int delta);
+void blip_endFrame(struct Blip *blip, uint32_t time);
+int blip_read(struct Blip *blip, int16_t *out, int count);
+
+static inline int blip_available(const struct Blip *blip) {
+    return (int)(blip->offset >> 32);
+}
+
+#endif
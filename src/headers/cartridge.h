@@ -0,0 +1,37 @@
+#ifndef CARTRIDGE_H
+#define CARTRIDGE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "./ppu.h"
+
+#define MAPPER_NSF 0xFF
+
+struct Expansion;
+
+/*
+    PRG is read through eight 4KB windows over $8000-$FFFF, so banks are
+    switched by moving a pointer. prgRam is the 8KB at $6000, if there is
+    any. expansion is the cartridge's sound chips, if it has any.
+*/
+struct Cartridge {
+    uint8_t *prg;
+    uint32_t prgSize;
+    uint8_t *prgWindows[8];
+    uint8_t *prgRam;
+    uint8_t *chr;
+    uint32_t chrSize;
+    uint8_t mapper;
+    enum Mirroring mirroring;
+    struct PPU *ppu;
+    struct Expansion *expansion;
+};
+
+int cartridge_load(struct Cartridge *cartridge, FILE *rom);
+void cartridge_free(struct Cartridge *cartridge);
+void cartridge_mapPrg(struct Cartridge *cartridge, int window, uint32_t bank);
+uint8_t cartridge_cpuRead(struct Cartridge *cartridge, uint16_t address);
+void cartridge_cpuWrite(struct Cartridge *cartridge, uint16_t address, uint8_t data);
+
+#endif
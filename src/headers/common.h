@@ -3,6 +3,12 @@
 
 #include <stdint.h>
 
+#include "./scheduler.h"
+
+struct PPU;
+struct APU;
+struct Cartridge;
+
 union StatusReg {
     struct {
         uint8_t c : 1;
@@ -35,6 +41,10 @@ struct NES {
     int cycle;
 
     void *surface;
+    struct Scheduler scheduler;
+    struct PPU *ppu;
+    struct APU *apu;
+    struct Cartridge *cartridge;
 };
 
 #endif
\ No newline at end of file
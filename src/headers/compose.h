@@ -0,0 +1,31 @@
+#ifndef COMPOSE_H
+#define COMPOSE_H
+
+#include <stdint.h>
+
+/*
+    Per scanline pixel kernels. merge applies PPUMASK clipping and sprite
+    priority to 256 background and sprite pixels, producing palette RAM
+    indices. palette turns the indices into colours. Sprite 0 hits are
+    predicted by the PPU, so merge does not look for them.
+*/
+struct ComposeKernels {
+    const char *name;
+    void (*merge)(uint8_t *indices, const uint8_t *background, const uint8_t *sprites, uint8_t mask);
+    void (*palette)(uint8_t *out, const uint8_t *indices, const uint8_t *palette, uint8_t greyscale);
+};
+
+extern const struct ComposeKernels compose_scalar;
+extern const struct ComposeKernels compose_sse2;
+extern const struct ComposeKernels compose_avx2;
+extern const struct ComposeKernels compose_neon;
+
+extern const struct ComposeKernels *compose;
+
+void compose_paletteScalar(uint8_t *out, const uint8_t *indices, const uint8_t *palette, uint8_t greyscale);
+
+void compose_init();
+int compose_select(const char *name);
+const struct ComposeKernels **compose_available();
+
+#endif
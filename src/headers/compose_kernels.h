@@ -0,0 +1,48 @@
+/*
+    Kernel bodies shared by the vector backends, included once per backend
+    after simd.h with SIMD_NAME set to the backend's name
+*/
+#define KERNEL_CAT(a, b) a##_##b
+#define KERNEL_NAME(a, b) KERNEL_CAT(a, b)
+#define KERNEL(name) KERNEL_NAME(name, SIMD_NAME)
+
+static vec KERNEL(leftClip)(int show) {
+    uint8_t lanes[SIMD_LANES];
+    memset(lanes, 0xFF, sizeof(lanes));
+    if (!show) {
+        memset(lanes, 0x00, 8);
+    }
+    return v_load(lanes);
+}
+
+static void KERNEL(merge)(uint8_t *indices, const uint8_t *background, const uint8_t *sprites, uint8_t mask) {
+    vec showBackground = v_splat((mask & 0x08) ? 0xFF : 0x00);
+    vec showSprites = v_splat((mask & 0x10) ? 0xFF : 0x00);
+    vec pattern = v_splat(0x03);
+
+    for (int x = 0; x < 256; x += SIMD_LANES) {
+        vec b = v_and(v_load(background + x), showBackground);
+        vec s = v_and(v_load(sprites + x), showSprites);
+        if (x == 0) {
+            b = v_and(b, KERNEL(leftClip)(mask & 0x02));
+            s = v_and(s, KERNEL(leftClip)(mask & 0x04));
+        }
+
+        vec backgroundClear = v_isZero(v_and(b, pattern));
+        vec spriteClear = v_isZero(v_and(s, pattern));
+        vec backgroundIndex = v_andnot(v_and(b, v_splat(0x0F)), backgroundClear);
+        vec spriteFront = v_or(v_isZero(v_and(s, v_splat(0x80))), backgroundClear);
+        vec useSprite = v_andnot(spriteFront, spriteClear);
+        v_store(indices + x, v_select(useSprite, v_and(s, v_splat(0x1F)), backgroundIndex));
+    }
+}
+
+#ifdef SIMD_LOOKUP
+static void KERNEL(palette)(uint8_t *out, const uint8_t *indices, const uint8_t *palette, uint8_t greyscale) {
+    vtable table = v_table32(palette);
+    vec grey = v_splat(greyscale);
+    for (int x = 0; x < 256; x += SIMD_LANES) {
+        v_store(out + x, v_and(v_lookup32(table, v_load(indices + x)), grey));
+    }
+}
+#endif
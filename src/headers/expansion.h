@@ -0,0 +1,103 @@
+#ifndef EXPANSION_H
+#define EXPANSION_H
+
+#include <stdint.h>
+
+#include "./apu.h"
+
+/*
+    The same bits an NSF header uses to list the chips it needs
+*/
+#define EXPANSION_VRC6 0x01
+#define EXPANSION_N163 0x10
+#define EXPANSION_5B 0x20
+#define EXPANSION_CHIPS (EXPANSION_VRC6 | EXPANSION_N163 | EXPANSION_5B)
+
+#define N163_CHANNELS 8
+
+struct VRC6Pulse {
+    uint8_t mode;
+    uint8_t duty;
+    uint8_t volume;
+    uint8_t enabled;
+    uint8_t step;
+    uint16_t period;
+};
+
+struct VRC6Saw {
+    uint8_t rate;
+    uint8_t enabled;
+    uint8_t step;
+    uint8_t accumulator;
+    uint16_t period;
+};
+
+/*
+    Konami's VRC6: two pulses with eight duties and a sawtooth. Channels
+    0 and 1 are the pulses and 2 the sawtooth.
+*/
+struct VRC6 {
+    struct VRC6Pulse pulse[2];
+    struct VRC6Saw saw;
+    uint8_t halt;
+    uint8_t shift;
+    uint64_t next[3];
+    uint64_t due[3];
+    int levels[3];
+};
+
+/*
+    Sunsoft's 5B, a YM2149 in all but name: three square tones that can
+    each be gated by one shared noise generator and take their volume
+    from one shared envelope. Sources 0-2 are the tones, 3 the noise and
+    4 the envelope.
+*/
+struct Sunsoft5B {
+    uint8_t address;
+    uint8_t registers[16];
+    uint8_t tone[3];
+    uint32_t noise;
+    uint8_t envelopeStep;
+    uint8_t envelopeAttack;
+    uint8_t envelopeHolding;
+    uint64_t next[5];
+    uint64_t due[5];
+    int level;
+};
+
+/*
+    Namco's 163: up to eight wavetable channels whose registers, phases
+    and 4 bit samples all live in 128 bytes of RAM on the chip. It plays
+    one channel at a time, 15 cycles each, so each channel is only
+    updated once a round of all of them.
+*/
+struct Namco163 {
+    uint8_t ram[128];
+    uint8_t address;
+    uint8_t increment;
+    uint64_t next[N163_CHANNELS];
+    uint64_t due[N163_CHANNELS];
+    int levels[N163_CHANNELS];
+};
+
+/*
+    Sound chips on the cartridge. They are run lazily like the APU's own
+    channels, caught up on their register accesses and when the APU ends
+    a frame, and add their changes of level into the APU's step buffer at
+    their own times. Nothing is attached unless a cartridge has one, so
+    the APU only ever checks for a NULL pointer otherwise.
+*/
+struct Expansion {
+    struct APU *apu;
+    uint8_t chips;
+    struct VRC6 vrc6;
+    struct Sunsoft5B sunsoft;
+    struct Namco163 namco;
+};
+
+void expansion_init(struct Expansion *expansion, struct APU *apu, uint8_t chips);
+int expansion_write(struct Expansion *expansion, uint16_t address, uint8_t data);
+uint8_t expansion_read(struct Expansion *expansion, uint16_t address);
+void expansion_catchUp(struct Expansion *expansion);
+
+#endif
@@ -2,9 +2,27 @@
 #define GUI_H
 
 #define SDL_MAIN_HANDLED
+#ifdef PINES_SYSTEM_SDL
+#include <SDL.h>
+#else
 #include "./../../lib/SDL/SDL/include/SDL2/SDL.h"
+#endif
+#include "./audiosink.h"
 
 SDL_Window* GUI_initialiseWindow();
 SDL_Surface* GUI_getSurface(SDL_Window *window);
+void GUI_closeWindow(SDL_Window* window);
+void GUI_stopSDL();
+int GUI_pollQuit();
+int GUI_initialiseOutput(SDL_Window *window, int rgb565, int vsync);
+void GUI_closeOutput();
+void GUI_presentFrame(SDL_Window *window, const uint8_t *colours, const uint8_t *emphasis);
+int GUI_openAudio(int rate);
+void GUI_writeAudio(const int16_t *samples, int count);
+void GUI_paceAudio(unsigned target);
+void GUI_audioStats(struct AudioStats *stats);
+int GUI_closeAudio();
+extern const struct AudioSink GUI_audioSink;
+void GUI_benchmarkPresent(const uint8_t *colours, const uint8_t *emphasis, int frames);
 
 #endif
\ No newline at end of file
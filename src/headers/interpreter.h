@@ -0,0 +1,10 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include "./common.h"
+
+void cpu_reset(struct NES *nes);
+int cpu_step(struct NES *nes);
+void cpu_execute(struct NES *nes);
+
+#endif
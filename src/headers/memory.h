@@ -3,7 +3,10 @@
 
 #include <stdint.h>
 
+#include "./common.h"
+
 uint8_t cpu_read(uint16_t address);
 void cpu_write(uint16_t address, uint8_t data);
+void memory_connect(struct NES *nes);
 
 #endif
\ No newline at end of file
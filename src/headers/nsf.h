@@ -0,0 +1,61 @@
+#ifndef NSF_H
+#define NSF_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "./common.h"
+#include "./apu.h"
+#include "./cartridge.h"
+#include "./expansion.h"
+
+#define NSF_CHIP_VRC6 0x01
+#define NSF_CHIP_VRC7 0x02
+#define NSF_CHIP_FDS 0x04
+#define NSF_CHIP_MMC5 0x08
+#define NSF_CHIP_N163 0x10
+#define NSF_CHIP_5B 0x20
+
+/*
+    A music rip: a game's sound code and data with the entry points a
+    player calls, INIT once per song and PLAY at speed microseconds apart.
+    Its data is mapped as a cartridge with eight 4KB windows.
+*/
+struct NSF {
+    struct Cartridge cartridge;
+    uint8_t songs;
+    uint8_t firstSong;
+    uint16_t load;
+    uint16_t init;
+    uint16_t play;
+    uint16_t speed;
+    uint8_t banks[8];
+    uint8_t bankswitched;
+    uint8_t chips;
+    char title[33];
+    char artist[33];
+    char copyright[33];
+};
+
+/*
+    Plays one song of an NSF on a machine with no PPU. PLAY is started by
+    a scheduler event, and while neither routine is running the CPU skips
+    straight to the next event instead of being stepped. The bus has room
+    for one machine, so there is one player per process.
+*/
+struct NSFPlayer {
+    struct NES nes;
+    struct APU apu;
+    struct Expansion expansion;
+    struct NSF *nsf;
+    uint64_t playStart;
+    uint64_t plays;
+    int playDue;
+};
+
+int nsf_load(struct NSF *nsf, FILE *file);
+void nsf_free(struct NSF *nsf);
+void nsf_start(struct NSFPlayer *player, struct NSF *nsf, int song, int sampleRate);
+void nsf_run(struct NSFPlayer *player, uint32_t cycles);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdint.h>
+
+#define OUTPUT_WIDTH 256
+#define OUTPUT_HEIGHT 240
+
+/*
+    Turns a frame of 6 bit colours into pixels of the display's format.
+    table holds every colour under every emphasis setting already packed for
+    the target, planes holds the same values split into bytes for the NEON
+    table lookups. convertRow is picked once for the format and the CPU.
+*/
+struct Output {
+    int bytesPerPixel;
+    uint32_t table[8][64];
+    uint8_t planes[8][4][64];
+    const char *name;
+    void (*convertRow)(const struct Output *output, uint8_t *dst, const uint8_t *colours, uint8_t emphasis);
+};
+
+int output_init(struct Output *output, int bytesPerPixel, uint32_t rmask, uint32_t gmask, uint32_t bmask, uint32_t amask);
+void output_convertFrame(const struct Output *output, uint8_t *dst, int pitch, const uint8_t *colours, const uint8_t *emphasis);
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef PPU_H
+#define PPU_H
+
+#include <stdint.h>
+
+#include "./tilecache.h"
+#include "./sprites.h"
+#include "./scheduler.h"
+#include "./ppulog.h"
+
+#define PPU_WIDTH 256
+#define PPU_HEIGHT 240
+#define PPU_DOTS_PER_LINE 341
+#define PPU_LINES_PER_FRAME 262
+#define PPU_PRERENDER_LINE 261
+#define PPU_VBLANK_LINE 241
+
+enum Mirroring {
+    MIRROR_HORIZONTAL,
+    MIRROR_VERTICAL,
+    MIRROR_SINGLE_LOW,
+    MIRROR_SINGLE_HIGH,
+    MIRROR_FOUR_SCREEN
+};
+
+struct PPUThread;
+struct BackgroundLayer;
+
+enum PPUCore {
+    PPU_CORE_SCANLINE,
+    PPU_CORE_DOT
+};
+
+/*
+    Where the dot renderer is up to. The background shifter is 16 pixels
+    in the tile cache's byte per pixel form, low holding the 8 being drawn.
+    Latches hold the next tile as it is fetched.
+*/
+struct DotState {
+    uint64_t time;
+    int line;
+    int dot;
+    uint8_t nameLatch;
+    uint8_t paletteLatch;
+    uint64_t patternLatch;
+    uint64_t shiftLow;
+    uint64_t shiftHigh;
+    uint8_t secondary[SPRITES_PER_LINE];
+    int secondaryCount;
+};
+
+struct PPU {
+    uint8_t control;
+    uint8_t mask;
+    uint8_t status;
+    uint8_t oamAddress;
+    uint8_t readBuffer;
+    uint8_t fineX;
+    uint8_t writeToggle;
+    uint16_t vramAddress;
+    uint16_t tempAddress;
+
+    uint8_t nametables[0x1000];
+    uint8_t *nametableMap[4];
+    uint8_t palette[32];
+    uint8_t oam[256];
+    struct SpriteLists spriteLists;
+
+    uint8_t *chr;
+    uint32_t chrSize;
+    int chrIsRam;
+    uint8_t *chrBanks[8];
+    const uint64_t *tileBanks[8];
+    struct TileCache tiles;
+
+    enum PPUCore core;
+    struct DotState dot;
+    struct PPULog *log;
+    struct PPU *renderer;
+    struct PPUThread *thread;
+    struct BackgroundLayer *layer;
+
+    struct Scheduler *scheduler;
+    uint64_t frameStart;
+    int line;
+    int walked;
+    int oddFrame;
+    int frameReady;
+    int nmiPending;
+    int frameSkip;
+    int skipCount;
+    int skipping;
+
+    uint8_t backgroundLine[PPU_WIDTH + 16];
+    uint8_t spriteLine[PPU_WIDTH];
+    uint8_t frameBuffer[PPU_WIDTH * PPU_HEIGHT];
+    uint8_t emphasis[PPU_HEIGHT];
+};
+
+int ppu_init(struct PPU *ppu, struct Scheduler *scheduler, uint8_t *chr, uint32_t chrSize, enum Mirroring mirroring);
+void ppu_free(struct PPU *ppu);
+void ppu_setMirroring(struct PPU *ppu, enum Mirroring mirroring);
+void ppu_mapChr(struct PPU *ppu, int slot, int count, uint32_t bank);
+void ppu_setFrameSkip(struct PPU *ppu, int frameSkip);
+void ppu_setCore(struct PPU *ppu, enum PPUCore core);
+
+uint8_t ppu_readRegister(struct PPU *ppu, uint16_t address);
+void ppu_writeRegister(struct PPU *ppu, uint16_t address, uint8_t data);
+void ppu_oamDma(struct PPU *ppu, const uint8_t *page);
+
+void ppu_catchUp(struct PPU *ppu);
+
+int ppu_startThread(struct PPU *ppu);
+void ppu_renderChunk(struct PPU *renderer, struct PPULog *log, uint64_t end);
+int ppu_output(struct PPU *ppu, const uint8_t **pixels, const uint8_t **emphasis);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef PPUDOT_H
+#define PPUDOT_H
+
+#include "./ppu.h"
+
+void ppudot_start(struct PPU *ppu);
+void ppudot_catchUp(struct PPU *ppu);
+
+#endif
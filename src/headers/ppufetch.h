@@ -0,0 +1,86 @@
+#ifndef PPUFETCH_H
+#define PPUFETCH_H
+
+#include <stdint.h>
+
+#include "./ppu.h"
+#include "./tilecache.h"
+
+/*
+    Fetch and scroll helpers shared by the scanline and dot renderers. All
+    pattern fetches go through the tile cache, so both see CHR the same way.
+*/
+
+static inline int ppu_renderingEnabled(const struct PPU *ppu) {
+    return (ppu->mask & 0x18) != 0;
+}
+
+static inline uint16_t ppu_incrementX(uint16_t v) {
+    return ((v & 0x001F) == 31) ? ((v & ~0x001F) ^ 0x0400) : v + 1;
+}
+
+static inline uint16_t ppu_incrementY(uint16_t v) {
+    if ((v & 0x7000) != 0x7000) {
+        return v + 0x1000;
+    }
+    v &= ~0x7000;
+    uint16_t coarseY = (v >> 5) & 0x1F;
+    if (coarseY == 29) {
+        coarseY = 0;
+        v ^= 0x0800;
+    }
+    else if (coarseY == 31) {
+        coarseY = 0;
+    }
+    else {
+        coarseY++;
+    }
+    return (v & ~0x03E0) | (coarseY << 5);
+}
+
+static inline uint8_t ppu_nameAt(const struct PPU *ppu, uint16_t v) {
+    return ppu->nametableMap[(v >> 10) & 3][v & 0x3FF];
+}
+
+/*
+    The 2 bit palette of the tile at v from its attribute byte
+*/
+static inline uint8_t ppu_paletteAt(const struct PPU *ppu, uint16_t v) {
+    uint8_t attribute = ppu->nametableMap[(v >> 10) & 3][0x3C0 | ((v >> 4) & 0x38) | ((v >> 2) & 0x07)];
+    return (attribute >> (((v >> 4) & 0x04) | (v & 0x02))) & 0x03;
+}
+
+static inline uint64_t ppu_patternRow(const struct PPU *ppu, uint8_t name, uint16_t v) {
+    uint16_t pattern = ((ppu->control & 0x10) << 8) | ((uint16_t)name << 4) | ((v >> 12) & 0x07);
+    return tilecache_row(ppu->tileBanks[pattern >> 10], pattern);
+}
+
+static inline uint64_t ppu_backgroundPattern(const struct PPU *ppu, uint16_t v) {
+    return ppu_patternRow(ppu, ppu_nameAt(ppu, v), v);
+}
+
+/*
+    The row of a sprite's pattern that falls on a line, already flipped
+*/
+static inline uint64_t ppu_spritePattern(const struct PPU *ppu, const uint8_t *entry, int row, int height) {
+    if (entry[2] & 0x80) {
+        row = height - 1 - row;
+    }
+    uint16_t pattern;
+    if (height == 16) {
+        pattern = ((uint16_t)(entry[1] & 0x01) << 12) | ((uint16_t)(entry[1] & 0xFE) << 4);
+        if (row >= 8) {
+            pattern += 16;
+            row -= 8;
+        }
+    }
+    else {
+        pattern = ((ppu->control & 0x08) << 9) | ((uint16_t)entry[1] << 4);
+    }
+    pattern |= row;
+
+    uint64_t pixels = tilecache_row(ppu->tileBanks[pattern >> 10], pattern);
+    return (entry[2] & 0x40) ? tilecache_mirror(pixels) : pixels;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef PPULOG_H
+#define PPULOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PPULOG_CAPACITY 4096
+#define PPULOG_PAGES 8
+
+/*
+    What a log entry changes. Writes to $2005 and $2006 are logged already
+    resolved against the write toggle, so replaying never needs it.
+*/
+enum LogKind {
+    LOG_CONTROL,
+    LOG_MASK,
+    LOG_SCROLL_FIRST,
+    LOG_SCROLL_SECOND,
+    LOG_ADDRESS_FIRST,
+    LOG_ADDRESS_SECOND,
+    LOG_DATA_WRITE,
+    LOG_DATA_READ,
+    LOG_OAM_DATA,
+    LOG_OAM_DMA,
+    LOG_CHR_BANK,
+    LOG_MIRRORING,
+    LOG_FRAME
+};
+
+/*
+    address is the OAM address for LOG_OAM_DATA and the bank for
+    LOG_CHR_BANK, whose data is slot | count << 4. LOG_OAM_DMA's page is
+    the oldest one not yet replayed. LOG_FRAME marks pre-render, address
+    being the dots until the frame starts and data whether it is skipped.
+*/
+struct LogEntry {
+    uint64_t time;
+    uint16_t address;
+    uint8_t kind;
+    uint8_t data;
+};
+
+/*
+    A preallocated ring of timestamped changes to PPU state. The CPU side
+    only appends and the renderer only takes from the tail, in order.
+*/
+struct PPULog {
+    struct LogEntry entries[PPULOG_CAPACITY];
+    uint32_t head;
+    uint32_t tail;
+    uint8_t pages[PPULOG_PAGES][256];
+    uint32_t pageHead;
+    uint32_t pageTail;
+};
+
+void ppulog_init(struct PPULog *log);
+int ppulog_append(struct PPULog *log, uint64_t time, uint8_t kind, uint16_t address, uint8_t data);
+int ppulog_appendPage(struct PPULog *log, uint64_t time, const uint8_t *page);
+
+/*
+    Whether either the entries or the DMA pages have run out of room
+*/
+static inline int ppulog_full(const struct PPULog *log) {
+    return log->head - log->tail == PPULOG_CAPACITY || log->pageHead - log->pageTail == PPULOG_PAGES;
+}
+
+static inline const struct LogEntry *ppulog_peek(const struct PPULog *log) {
+    return (log->head == log->tail) ? NULL : &log->entries[log->tail % PPULOG_CAPACITY];
+}
+
+static inline const uint8_t *ppulog_page(const struct PPULog *log) {
+    return log->pages[log->pageTail % PPULOG_PAGES];
+}
+
+static inline void ppulog_pop(struct PPULog *log) {
+    if (log->entries[log->tail % PPULOG_CAPACITY].kind == LOG_OAM_DMA) {
+        log->pageTail++;
+    }
+    log->tail++;
+}
+
+#endif
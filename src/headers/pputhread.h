@@ -0,0 +1,49 @@
+#ifndef PPUTHREAD_H
+#define PPUTHREAD_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "./ppu.h"
+#include "./ppulog.h"
+
+/*
+    Runs the renderer on its own thread, one frame behind the CPU. The CPU
+    fills one log while the renderer replays the other, and they swap at
+    vblank or when a log fills. Finished frames are copied out so the CPU
+    side can present one while the next is being drawn.
+
+    Each counter is written by one thread only, so handing off is just a
+    release store on one side and an acquire load on the other. A side
+    left waiting spins briefly then sleeps on wake, which is signalled
+    after every store, so neither keeps a core busy while the other works.
+*/
+struct PPUThread {
+    pthread_t thread;
+    struct PPU *renderer;
+    struct PPULog logs[2];
+    uint64_t ends[2];
+    atomic_uint submitted;
+    atomic_uint consumed;
+    atomic_uint framesDone;
+    atomic_int running;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    unsigned framesSubmitted;
+
+    uint8_t frames[2][PPU_WIDTH * PPU_HEIGHT];
+    uint8_t emphasis[2][PPU_HEIGHT];
+    int skipped[2];
+};
+
+int pputhread_start(struct PPUThread *thread, struct PPU *renderer);
+void pputhread_stop(struct PPUThread *thread);
+struct PPULog *pputhread_submit(struct PPUThread *thread, uint64_t end, int frameEnd);
+int pputhread_frame(struct PPUThread *thread, const uint8_t **pixels, const uint8_t **emphasis);
+
+static inline struct PPULog *pputhread_log(struct PPUThread *thread) {
+    return &thread->logs[atomic_load_explicit(&thread->submitted, memory_order_relaxed) & 1];
+}
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef RATECONTROL_H
+#define RATECONTROL_H
+
+#define RATE_MAX_DELTA 0.005
+
+/*
+    Dynamic rate control. The emulator runs at whatever speed presenting
+    lets it, and the sound card plays at its own, so the rate samples are
+    made at is nudged by at most RATE_MAX_DELTA either way to hold the
+    audio ring at target samples. A correction that small can't be heard
+    as a change of pitch. The fill level jumps by a whole callback's worth
+    at a time, so it is smoothed before use.
+
+    Correcting in proportion to the error alone would settle with the ring
+    short of target by however much correction the display needs, so a
+    slow integral term takes over the steady part.
+*/
+struct RateControl {
+    double target;
+    double average;
+    double integral;
+    double ratio;
+};
+
+void ratecontrol_init(struct RateControl *control, unsigned target);
+double ratecontrol_update(struct RateControl *control, unsigned fill);
+
+#endif
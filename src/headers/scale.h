@@ -0,0 +1,21 @@
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <stdint.h>
+
+/*
+    Integer nearest neighbour scaling. row widens one line of pixels by the
+    factor, the remaining factor - 1 output lines are copies of the first.
+    row is picked once for the format, the factor and the CPU.
+*/
+struct Scaler {
+    int bytesPerPixel;
+    int factor;
+    const char *name;
+    void (*row)(uint8_t *dst, const uint8_t *src, int width);
+};
+
+int scale_init(struct Scaler *scaler, int bytesPerPixel, int factor);
+void scale_duplicate(const struct Scaler *scaler, uint8_t *dst, int dstPitch, int width);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+#define SCHEDULER_NEVER UINT64_MAX
+#define CPU_DOTS 3
+
+/*
+    Timestamps are in PPU dots since power on, a CPU cycle is CPU_DOTS dots.
+    Each event type has a single slot, rescheduling an event replaces it.
+*/
+enum Event {
+    EVENT_VBLANK,
+    EVENT_PRERENDER,
+    EVENT_SPRITE0_HIT,
+    EVENT_SPRITE_OVERFLOW,
+    EVENT_APU,
+    EVENT_NSF_PLAY,
+    EVENT_COUNT
+};
+
+struct Scheduler {
+    uint64_t now;
+    uint64_t next;
+    uint64_t deadline[EVENT_COUNT];
+    void (*handlers[EVENT_COUNT])(void *context, enum Event event);
+    void *contexts[EVENT_COUNT];
+};
+
+void scheduler_init(struct Scheduler *scheduler);
+void scheduler_setHandler(struct Scheduler *scheduler, enum Event event, void (*handler)(void *context, enum Event event), void *context);
+void scheduler_schedule(struct Scheduler *scheduler, enum Event event, uint64_t time);
+void scheduler_cancel(struct Scheduler *scheduler, enum Event event);
+int scheduler_pop(struct Scheduler *scheduler);
+void scheduler_run(struct Scheduler *scheduler);
+
+static inline int scheduler_due(const struct Scheduler *scheduler, enum Event event) {
+    return scheduler->deadline[event] <= scheduler->now;
+}
+
+#endif
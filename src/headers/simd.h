@@ -0,0 +1,120 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+
+/*
+    The handful of byte vector operations the pixel kernels are written
+    against. Define SIMD_SSE2, SIMD_AVX2 or SIMD_NEON before including, each
+    backend supplies:
+
+    vec     SIMD_LANES bytes
+
+    v_load, v_store, v_splat, v_and, v_or, v_andnot (a & ~b), v_isZero
+    (0xFF in lanes that are 0) and v_select (mask ? a : b)
+
+    Backends with a byte shuffle also define SIMD_LOOKUP and supply vtable,
+    a prepared 32 entry byte lookup table, with v_table32 and v_lookup32,
+    which indexes it with the low 5 bits of each lane.
+*/
+
+#if defined(SIMD_AVX2)
+#include <immintrin.h>
+
+#define SIMD_LANES 32
+#define SIMD_LOOKUP
+typedef __m256i vec;
+typedef struct { __m256i low; __m256i high; } vtable;
+
+static inline vec v_load(const uint8_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+static inline void v_store(uint8_t *p, vec a) { _mm256_storeu_si256((__m256i *)p, a); }
+static inline vec v_splat(uint8_t value) { return _mm256_set1_epi8((char)value); }
+static inline vec v_and(vec a, vec b) { return _mm256_and_si256(a, b); }
+static inline vec v_or(vec a, vec b) { return _mm256_or_si256(a, b); }
+static inline vec v_andnot(vec a, vec b) { return _mm256_andnot_si256(b, a); }
+static inline vec v_isZero(vec a) { return _mm256_cmpeq_epi8(a, _mm256_setzero_si256()); }
+static inline vec v_select(vec mask, vec a, vec b) { return _mm256_blendv_epi8(b, a, mask); }
+
+static inline vtable v_table32(const uint8_t *table) {
+    vtable t;
+    t.low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)table));
+    t.high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(table + 16)));
+    return t;
+}
+
+static inline vec v_lookup32(vtable t, vec index) {
+    index = _mm256_and_si256(index, _mm256_set1_epi8(0x1F));
+    vec high = _mm256_cmpeq_epi8(_mm256_and_si256(index, _mm256_set1_epi8(0x10)), _mm256_set1_epi8(0x10));
+    return _mm256_blendv_epi8(_mm256_shuffle_epi8(t.low, index), _mm256_shuffle_epi8(t.high, index), high);
+}
+
+#elif defined(SIMD_SSE2)
+#include <emmintrin.h>
+
+/*
+    SSE2 has no byte shuffle, and a lookup built from compares over all 32
+    entries costs more than the scalar loads, so there is no v_lookup32
+*/
+#define SIMD_LANES 16
+typedef __m128i vec;
+
+static inline vec v_load(const uint8_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+static inline void v_store(uint8_t *p, vec a) { _mm_storeu_si128((__m128i *)p, a); }
+static inline vec v_splat(uint8_t value) { return _mm_set1_epi8((char)value); }
+static inline vec v_and(vec a, vec b) { return _mm_and_si128(a, b); }
+static inline vec v_or(vec a, vec b) { return _mm_or_si128(a, b); }
+static inline vec v_andnot(vec a, vec b) { return _mm_andnot_si128(b, a); }
+static inline vec v_isZero(vec a) { return _mm_cmpeq_epi8(a, _mm_setzero_si128()); }
+static inline vec v_select(vec mask, vec a, vec b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+
+#elif defined(SIMD_NEON)
+#include <arm_neon.h>
+
+#define SIMD_LANES 16
+#define SIMD_LOOKUP
+typedef uint8x16_t vec;
+#if defined(__aarch64__)
+typedef uint8x16x2_t vtable;
+#else
+typedef uint8x8x4_t vtable;
+#endif
+
+static inline vec v_load(const uint8_t *p) { return vld1q_u8(p); }
+static inline void v_store(uint8_t *p, vec a) { vst1q_u8(p, a); }
+static inline vec v_splat(uint8_t value) { return vdupq_n_u8(value); }
+static inline vec v_and(vec a, vec b) { return vandq_u8(a, b); }
+static inline vec v_or(vec a, vec b) { return vorrq_u8(a, b); }
+static inline vec v_andnot(vec a, vec b) { return vbicq_u8(a, b); }
+static inline vec v_isZero(vec a) { return vceqq_u8(a, vdupq_n_u8(0)); }
+static inline vec v_select(vec mask, vec a, vec b) { return vbslq_u8(mask, a, b); }
+
+#if defined(__aarch64__)
+static inline vtable v_table32(const uint8_t *table) {
+    vtable t;
+    t.val[0] = vld1q_u8(table);
+    t.val[1] = vld1q_u8(table + 16);
+    return t;
+}
+
+static inline vec v_lookup32(vtable t, vec index) {
+    return vqtbl2q_u8(t, vandq_u8(index, vdupq_n_u8(0x1F)));
+}
+#else
+static inline vtable v_table32(const uint8_t *table) {
+    vtable t;
+    t.val[0] = vld1_u8(table);
+    t.val[1] = vld1_u8(table + 8);
+    t.val[2] = vld1_u8(table + 16);
+    t.val[3] = vld1_u8(table + 24);
+    return t;
+}
+
+static inline vec v_lookup32(vtable t, vec index) {
+    index = vandq_u8(index, vdupq_n_u8(0x1F));
+    return vcombine_u8(vtbl4_u8(t, vget_low_u8(index)), vtbl4_u8(t, vget_high_u8(index)));
+}
+#endif
+
+#endif
+
+#endif
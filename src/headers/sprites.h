@@ -0,0 +1,24 @@
+#ifndef SPRITES_H
+#define SPRITES_H
+
+#include <stdint.h>
+
+#define SPRITE_LINES 240
+#define SPRITES_PER_LINE 8
+
+/*
+    For every output line, the OAM indices of the first eight sprites on it
+    and whether more were in range. Only rebuilt when OAM or the sprite
+    height changes.
+*/
+struct SpriteLists {
+    uint8_t count[SPRITE_LINES];
+    uint8_t overflow[SPRITE_LINES];
+    uint8_t sprites[SPRITE_LINES][SPRITES_PER_LINE];
+    int height;
+    int dirty;
+};
+
+void sprites_build(struct SpriteLists *lists, const uint8_t *oam, int height);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef STRETCH_H
+#define STRETCH_H
+
+#include <stdint.h>
+
+#define STRETCH_MIN_SPEED 0.25
+#define STRETCH_MAX_SPEED 8.0
+#define STRETCH_MAX_RATE 96000
+#define STRETCH_INPUT 32768
+#define STRETCH_MAX_OVERLAP (STRETCH_MAX_RATE / 125)
+
+/*
+    Changes how long sound lasts without changing its pitch, so fast
+    forward and slow motion still sound like the game (WSOLA). Output is
+    built from sequences of input a fixed length apart, each taken from
+    wherever in a small window of the input lines up best with how the
+    last one would have carried on, and crossfaded into it. speed is how
+    many input samples go into each output sample.
+*/
+struct Stretch {
+    double speed;
+    int sequence;
+    int overlap;
+    int seek;
+    double skip;
+    int16_t input[STRETCH_INPUT];
+    int inputCount;
+    int16_t tail[STRETCH_MAX_OVERLAP];
+    int haveTail;
+};
+
+void stretch_init(struct Stretch *stretch, int sampleRate);
+void stretch_setSpeed(struct Stretch *stretch, double speed);
+int stretch_process(struct Stretch *stretch, const int16_t *in, int count, int16_t *out, int room);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <stdint.h>
+
+#define TILE_BYTES 16
+#define TILE_ROWS 8
+
+/*
+    CHR tiles predecoded from their two bitplanes into one byte per pixel.
+    Each tile row is a single uint64_t whose lowest byte is the leftmost
+    pixel, so a fetch of 8 pixels is one load. Writes to CHR-RAM only mark
+    the tile in the dirty bitmap; dirty tiles are decoded again on flush.
+*/
+struct TileCache {
+    uint64_t *rows;
+    const uint8_t *chr;
+    uint32_t tileCount;
+    uint32_t *dirty;
+    uint32_t dirtyCount;
+};
+
+int tilecache_init(struct TileCache *cache, const uint8_t *chr, uint32_t size);
+void tilecache_free(struct TileCache *cache);
+void tilecache_markDirty(struct TileCache *cache, uint32_t address);
+void tilecache_flush(struct TileCache *cache);
+
+static inline uint64_t tilecache_row(const uint64_t *tiles, uint16_t address) {
+    return tiles[((address >> 4) & 0x3F) * TILE_ROWS + (address & 0x07)];
+}
+
+/*
+    Pixels are one per byte, so a horizontal flip is a byte swap
+*/
+static inline uint64_t tilecache_mirror(uint64_t row) {
+    return __builtin_bswap64(row);
+}
+
+#endif
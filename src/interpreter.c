@@ -2,6 +2,10 @@
 
 #include "./headers/common.h"
 #include "./headers/memory.h"
+#include "./headers/interpreter.h"
+#include "./headers/ppu.h"
+#include "./headers/apu.h"
+#include "./headers/scheduler.h"
 
 
 struct Instruction {
@@ -222,6 +226,9 @@ void bpl(struct NES *nes, uint16_t (*mode)(struct NES*)) {
         nes->branchCycle = 1;
         nes->oopsCycle++;
     }
+    else {
+        nes->programCounter += 2;
+    }
 }
 
 void bmi(struct NES *nes, uint16_t (*mode)(struct NES*)) {
@@ -230,6 +237,9 @@ void bmi(struct NES *nes, uint16_t (*mode)(struct NES*)) {
         nes->branchCycle = 1;
         nes->oopsCycle++;
     }
+    else {
+        nes->programCounter += 2;
+    }
 }
 
 void bvc(struct NES *nes, uint16_t (*mode)(struct NES*)) {
@@ -238,6 +248,9 @@ void bvc(struct NES *nes, uint16_t (*mode)(struct NES*)) {
         nes->branchCycle = 1;
         nes->oopsCycle++;
     }
+    else {
+        nes->programCounter += 2;
+    }
 }
 
 void bvs(struct NES *nes, uint16_t (*mode)(struct NES*)) {
@@ -246,6 +259,9 @@ void bvs(struct NES *nes, uint16_t (*mode)(struct NES*)) {
         nes->branchCycle = 1;
         nes->oopsCycle++;
     }
+    else {
+        nes->programCounter += 2;
+    }
 }
 
 void bcc(struct NES *nes, uint16_t (*mode)(struct NES*)) {
@@ -254,6 +270,9 @@ void bcc(struct NES *nes, uint16_t (*mode)(struct NES*)) {
         nes->branchCycle = 1;
         nes->oopsCycle++;
     }
+    else {
+        nes->programCounter += 2;
+    }
 }
 
 void bcs(struct NES *nes, uint16_t (*mode)(struct NES*)) {
@@ -262,6 +281,9 @@ void bcs(struct NES *nes, uint16_t (*mode)(struct NES*)) {
         nes->branchCycle = 1;
         nes->oopsCycle++;
     }
+    else {
+        nes->programCounter += 2;
+    }
 }
 
 void bne(struct NES *nes, uint16_t (*mode)(struct NES*)) {
@@ -270,6 +292,9 @@ void bne(struct NES *nes, uint16_t (*mode)(struct NES*)) {
         nes->branchCycle = 1;
         nes->oopsCycle++;
     }
+    else {
+        nes->programCounter += 2;
+    }
 }
 
 void beq(struct NES *nes, uint16_t (*mode)(struct NES*)) {
@@ -278,6 +303,9 @@ void beq(struct NES *nes, uint16_t (*mode)(struct NES*)) {
         nes->branchCycle = 1;
         nes->oopsCycle++;
     }
+    else {
+        nes->programCounter += 2;
+    }
 }
 
 
@@ -364,6 +392,7 @@ void jmp(struct NES *nes, uint16_t (*mode)(struct NES*)) {
 }
 
 void jsr(struct NES *nes, uint16_t (*mode)(struct NES*)) {
+    uint16_t destination = mode(nes);
     nes->programCounter--;
     uint8_t temp = (nes->programCounter >> 8);
     cpu_write(nes->stackPointer + 0x0100, temp);
@@ -371,7 +400,7 @@ void jsr(struct NES *nes, uint16_t (*mode)(struct NES*)) {
     temp = nes->programCounter;
     cpu_write(nes->stackPointer + 0x0100, temp);
     nes->stackPointer--;
-    nes->programCounter = mode(nes);
+    nes->programCounter = destination;
 }
 
 void rts(struct NES *nes, uint16_t (*mode)(struct NES*)) {
@@ -638,29 +667,75 @@ struct Instruction opcodes[256] = {
 /*  ---------
     Main loop
     --------- */
-void cpu_execute (struct NES *nes) {
+void cpu_reset(struct NES *nes) {
     nes->programCounter = (((uint16_t)cpu_read(0xFFFD)) << 8) | cpu_read(0xFFFC);
-    struct Instruction currentOp;
-    uint8_t opcode = cpu_read(nes->programCounter);
-
-    while (1) {
-        currentOp = opcodes[opcode];
-        currentOp.op(nes, currentOp.mode);
+    nes->stackPointer = 0xFD;
+    nes->statusRegister.i = 1;
+    nes->statusRegister.u = 1;
+}
 
-        int cycles = ((nes->oopsCycle == 2) ? 1 : 0);
-        cycles += currentOp.cycles;
-        cycles += nes->branchCycle;
-        while (cycles > 0) {
-            
-        }
-        nes->oopsCycle = 0;
-        nes->branchCycle = 0;
+static int interrupt(struct NES *nes, uint16_t vector) {
+    cpu_write(nes->stackPointer + 0x0100, nes->programCounter >> 8);
+    nes->stackPointer--;
+    cpu_write(nes->stackPointer + 0x0100, nes->programCounter & 0xFF);
+    nes->stackPointer--;
+    nes->statusRegister.b = 0;
+    nes->statusRegister.u = 1;
+    cpu_write(nes->stackPointer + 0x0100, nes->statusRegister.reg);
+    nes->stackPointer--;
+    nes->statusRegister.i = 1;
+    nes->programCounter = (((uint16_t)cpu_read(vector + 1)) << 8) | cpu_read(vector);
+    return 7;
+}
 
-        if (nes->pendingNMI) {
+/*
+    Runs one instruction, then moves time on, dispatches whatever the
+    scheduler has due and brings the APU up to date before taking
+    interrupts
+*/
+int cpu_step(struct NES *nes) {
+    uint8_t opcode = cpu_read(nes->programCounter);
+    struct Instruction currentOp = opcodes[opcode];
+    currentOp.op(nes, currentOp.mode);
+
+    int cycles = ((nes->oopsCycle == 2) ? 1 : 0);
+    cycles += currentOp.cycles;
+    cycles += nes->branchCycle;
+    cycles += nes->dmaCycles;
+    nes->dmaCycles = 0;
+    nes->oopsCycle = 0;
+    nes->branchCycle = 0;
+
+    nes->scheduler.now += (uint64_t)cycles * CPU_DOTS;
+    if (nes->scheduler.next <= nes->scheduler.now) {
+        scheduler_run(&nes->scheduler);
+    }
+    if (nes->ppu != NULL && nes->ppu->nmiPending) {
+        nes->ppu->nmiPending = 0;
+        nes->pendingNMI = 1;
+    }
+    nes->pendingIRQ = apu_irq(nes->apu);
 
-        }
-        else if (nes->pendingIRQ) {
+    if (nes->pendingNMI) {
+        nes->pendingNMI = 0;
+        int extra = interrupt(nes, 0xFFFA);
+        nes->scheduler.now += (uint64_t)extra * CPU_DOTS;
+        cycles += extra;
+    }
+    else if (nes->pendingIRQ && !nes->statusRegister.i) {
+        int extra = interrupt(nes, 0xFFFE);
+        nes->scheduler.now += (uint64_t)extra * CPU_DOTS;
+        cycles += extra;
+    }
+    return cycles;
+}
 
-        }
+/*
+    Runs until the PPU has a finished frame
+*/
+void cpu_execute(struct NES *nes) {
+    nes->ppu->frameReady = 0;
+    while (!nes->ppu->frameReady) {
+        cpu_step(nes);
     }
-}
\ No newline at end of file
+}
@@ -1,9 +1,67 @@
 #include <stdint.h>
+#include <string.h>
+
+#include "./headers/common.h"
+#include "./headers/memory.h"
+#include "./headers/ppu.h"
+#include "./headers/apu.h"
+#include "./headers/cartridge.h"
+
+static uint8_t ram[0x0800];
+static struct NES *console;
+
+
+/*
+    Gives the bus access to the devices hanging off it, with RAM cleared,
+    and gives the DMC its own way to PRG. The PPU may be left out, for
+    playing music rips.
+*/
+void memory_connect(struct NES *nes) {
+    console = nes;
+    memset(ram, 0, sizeof(ram));
+    apu_connect(nes->apu, nes->cartridge->prgWindows, &nes->dmaCycles);
+}
 
 uint8_t cpu_read(uint16_t address) {
-    return 0;
+    if (address < 0x2000) {
+        return ram[address & 0x07FF];
+    }
+    if (address < 0x4000) {
+        return (console->ppu != NULL) ? ppu_readRegister(console->ppu, address) : 0;
+    }
+    if (address == 0x4015) {
+        return apu_readStatus(console->apu);
+    }
+    if (address < 0x4020) {
+        return 0;
+    }
+    return cartridge_cpuRead(console->cartridge, address);
 }
 
 void cpu_write(uint16_t address, uint8_t data) {
-
-}
\ No newline at end of file
+    if (address < 0x2000) {
+        ram[address & 0x07FF] = data;
+    }
+    else if (address < 0x4000) {
+        if (console->ppu != NULL) {
+            ppu_writeRegister(console->ppu, address, data);
+        }
+    }
+    else if (address == 0x4014) {
+        uint8_t page[256];
+        for (int i = 0; i < 256; i++) {
+            page[i] = cpu_read(((uint16_t)data << 8) | i);
+        }
+        if (console->ppu != NULL) {
+            ppu_oamDma(console->ppu, page);
+        }
+        apu_oamDma(console->apu, 513);
+        console->dmaCycles += 513;
+    }
+    else if (address < 0x4018) {
+        apu_writeRegister(console->apu, address, data);
+    }
+    else if (address >= 0x4020) {
+        cartridge_cpuWrite(console->cartridge, address, data);
+    }
+}
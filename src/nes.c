@@ -1,16 +1,45 @@
 #include <dirent.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <time.h>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
+#ifndef PINES_HEADLESS
 #include "./headers/gui.h"
+#endif
 #include "./headers/common.h"
+#include "./headers/memory.h"
+#include "./headers/ppu.h"
+#include "./headers/apu.h"
+#include "./headers/expansion.h"
+#include "./headers/cartridge.h"
+#include "./headers/compose.h"
+#include "./headers/interpreter.h"
+#include "./headers/scheduler.h"
+#include "./headers/ratecontrol.h"
+#include "./headers/audiofile.h"
+#include "./headers/nsf.h"
+#include "./headers/stretch.h"
+
+#define SAMPLE_RATE 48000
+#define FRAME_CYCLES 29781
+#define MAX_JOBS 64
+#define FRAME_INTERVAL 60
 
 
 /*
     Lists files present in the Roms folder, and then returns the selected file
+    and copies its name into name
 */
-FILE* loadROM() {
+FILE* loadROM(char *name) {
 
     DIR* roms = opendir("./../Roms");
     if (roms == NULL) {
@@ -42,10 +71,11 @@ FILE* loadROM() {
             scanf("%d", &chosen);
     }
     printf("You have chosen %s\n", files[chosen].d_name);
+    strcpy(name, files[chosen].d_name);
 
     FILE *rom;
     char path[280] = "./../Roms/";
-    strncat(path, files[chosen].d_name, strlen(files[chosen].d_name));
+    strncat(path, files[chosen].d_name, sizeof(path) - strlen(path) - 1);
     rom = fopen(path, "rb");
     free(files);
     
@@ -56,12 +86,1045 @@ FILE* loadROM() {
 
 
 /*
-    Entry point into the program
+    Opens the ROM at path for runs that can't stop to ask, copying its file
+    name into name. Returns NULL if it can't be opened.
+*/
+FILE* openROM(const char *path, char *name) {
+    const char *base = path;
+    for (const char *c = path; *c; c++) {
+        if (*c == '/' || *c == '\\') {
+            base = c + 1;
+        }
+    }
+    strncpy(name, base, 255);
+    name[255] = '\0';
+    FILE *rom = fopen(path, "rb");
+    if (rom != NULL) {
+        int magic = 0;
+        fread(&magic, sizeof(int), 1, rom);
+    }
+    return rom;
+}
+
+
+/*
+    Roms/catalogue.txt lists ROMs that need special treatment, one per line
+    as the file name followed by options. "dot" selects the dot accurate
+    PPU. Returns the PPU the catalogue asks for, or -1 if the ROM is not in
+    it.
+*/
+int catalogueCore(const char *name) {
+    FILE *catalogue = fopen("./../Roms/catalogue.txt", "r");
+    if (catalogue == NULL) {
+        return -1;
+    }
+    char line[512];
+    int core = -1;
+    size_t length = strlen(name);
+    while (core < 0 && fgets(line, sizeof(line), catalogue) != NULL) {
+        if (strncmp(line, name, length) == 0 && (line[length] == ' ' || line[length] == '\t')) {
+            core = (strstr(line + length, "dot") != NULL) ? PPU_CORE_DOT : PPU_CORE_SCANLINE;
+        }
+    }
+    fclose(catalogue);
+    return core;
+}
+
+
+/*
+    Command line flags
+*/
+struct Options {
+    int rgb565;
+    int benchmarkPresent;
+    int frameSkip;
+    int core;
+    int diffFrames;
+    int renderThread;
+    int stats;
+    int noVsync;
+    int benchmarkAudio;
+    int benchmarkStretch;
+    int testCompose;
+    int testExpansion;
+    double speed;
+    const char *audioOut;
+    int headlessFrames;
+    const char *framesOut;
+    int frameInterval;
+    const char *statsOut;
+    const char *romPath;
+    const char *nsfPath;
+    int track;
+    int seconds;
+    int jobs;
+    const char *program;
+};
+
+void parseOptions(int argc, char *argv[], struct Options *options) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rgb565") == 0) {
+            options->rgb565 = 1;
+        }
+        else if (strcmp(argv[i], "--bench-present") == 0) {
+            options->benchmarkPresent = 1;
+        }
+        else if (strcmp(argv[i], "--frame-skip") == 0 && i + 1 < argc) {
+            options->frameSkip = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--ppu") == 0 && i + 1 < argc) {
+            i++;
+            options->core = (strcmp(argv[i], "dot") == 0) ? PPU_CORE_DOT : PPU_CORE_SCANLINE;
+        }
+        else if (strcmp(argv[i], "--diff-ppu") == 0 && i + 1 < argc) {
+            options->diffFrames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--render-thread") == 0) {
+            options->renderThread = 1;
+        }
+        else if (strcmp(argv[i], "--stats") == 0) {
+            options->stats = 1;
+        }
+        else if (strcmp(argv[i], "--no-vsync") == 0) {
+            options->noVsync = 1;
+        }
+        else if (strcmp(argv[i], "--bench-audio") == 0) {
+            options->benchmarkAudio = 1;
+        }
+        else if (strcmp(argv[i], "--bench-stretch") == 0) {
+            options->benchmarkStretch = 1;
+        }
+        else if (strcmp(argv[i], "--test-compose") == 0) {
+            options->testCompose = 1;
+        }
+        else if (strcmp(argv[i], "--test-expansion") == 0) {
+            options->testExpansion = 1;
+        }
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            options->speed = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--audio-out") == 0 && i + 1 < argc) {
+            options->audioOut = argv[++i];
+        }
+        else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            options->headlessFrames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--frames-out") == 0 && i + 1 < argc) {
+            options->framesOut = argv[++i];
+        }
+        else if (strcmp(argv[i], "--frame-interval") == 0 && i + 1 < argc) {
+            options->frameInterval = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--stats-out") == 0 && i + 1 < argc) {
+            options->statsOut = argv[++i];
+        }
+        else if (strcmp(argv[i], "--rom") == 0 && i + 1 < argc) {
+            options->romPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--nsf") == 0 && i + 1 < argc) {
+            options->nsfPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--track") == 0 && i + 1 < argc) {
+            options->track = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            options->seconds = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            options->jobs = atoi(argv[++i]);
+        }
+        else {
+            printf("Unknown option %s\n", argv[i]);
+            exit(1);
+        }
+    }
+}
+
+
+/*
+    A tune for the audio benchmarks: every channel playing, with a pulse
+    sweeping, the triangle and noise changing pitch every frame and raw
+    DMC writes like sampled speech
+*/
+static void startBenchmarkTune(struct APU *apu, struct Scheduler *scheduler) {
+    static const uint8_t setup[][2] = {
+        {0x15, 0x0F}, {0x00, 0xBF}, {0x01, 0xA2}, {0x02, 0x80}, {0x03, 0x01}, {0x04, 0x7F}, {0x06, 0x40}, {0x07, 0x00},
+        {0x08, 0xFF}, {0x0A, 0x60}, {0x0B, 0x00}, {0x0C, 0x3A}, {0x0E, 0x04}, {0x0F, 0x00}, {0x17, 0x40}
+    };
+    scheduler_init(scheduler);
+    apu_init(apu, scheduler, SAMPLE_RATE);
+    for (size_t i = 0; i < sizeof(setup) / sizeof(setup[0]); i++) {
+        apu_writeRegister(apu, 0x4000 + setup[i][0], setup[i][1]);
+    }
+}
+
+static int playBenchmarkFrame(struct APU *apu, struct Scheduler *scheduler, int frame, int16_t *samples) {
+    const int writes = 64;
+    for (int write = 0; write < writes; write++) {
+        scheduler->now += FRAME_CYCLES * CPU_DOTS / writes;
+        apu_writeRegister(apu, 0x4011, ((frame * writes + write) * 37) & 0x7F);
+    }
+    apu_writeRegister(apu, 0x400A, frame & 0xFF);
+    apu_writeRegister(apu, 0x400E, frame & 0x0F);
+    if (frame % 30 == 0) {
+        apu_writeRegister(apu, 0x4003, 0x01);
+    }
+    apu_endFrame(apu);
+    return apu_readSamples(apu, samples, BLIP_SIZE);
+}
+
+/*
+    Adds ten million steps of a frame's spacing straight into a step
+    buffer, reading it out a frame at a time, and returns the nanoseconds
+    a step took. The steps alone are too small a part of the tune to time
+    the kernels by.
+*/
+static double timeSteps() {
+    static struct Blip blip;
+    static int16_t samples[BLIP_SIZE];
+    const int frames = 5000;
+    const int steps = 2000;
+    blip_init(&blip, APU_CLOCK_RATE, SAMPLE_RATE);
+    clock_t start = clock();
+    for (int frame = 0; frame < frames; frame++) {
+        for (int step = 0; step < steps; step++) {
+            blip_addDelta(&blip, (uint32_t)(step * FRAME_CYCLES / steps), (step & 1) ? 300 : -300);
+        }
+        blip_endFrame(&blip, FRAME_CYCLES);
+        blip_read(&blip, samples, BLIP_SIZE);
+    }
+    return (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / ((double)frames * steps);
+}
+
+/*
+    Plays the benchmark tune for ten minutes of emulated time on each step
+    kernel and reports how fast samples come out, then times the kernels'
+    steps on their own
+*/
+void benchmarkAudio() {
+    static struct APU apu;
+    static int16_t samples[BLIP_SIZE];
+    struct Scheduler scheduler;
+    const int frames = 36000;
+    for (const struct BlipKernels **kernels = blip_kernelsAvailable(); *kernels; kernels++) {
+        startBenchmarkTune(&apu, &scheduler);
+        blip_kernels = *kernels;
+
+        long produced = 0;
+        clock_t start = clock();
+        for (int frame = 0; frame < frames; frame++) {
+            produced += playBenchmarkFrame(&apu, &scheduler, frame, samples);
+        }
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+        printf("%s kernels: %.0f samples per second, %.0f times real time\n", (*kernels)->name, produced / seconds, produced / seconds / SAMPLE_RATE);
+    }
+    for (const struct BlipKernels **kernels = blip_kernelsAvailable(); *kernels; kernels++) {
+        blip_kernels = *kernels;
+        printf("%s kernels: %.2f ns per step\n", (*kernels)->name, timeSteps());
+    }
+}
+
+/*
+    Time stretches ten minutes of the benchmark tune, a frame's worth at a
+    time as the main loop does, at a few speeds and reports what a second
+    of the sound that comes out costs. The tune is held whole, about 70 MB,
+    so the stretcher is timed alone
+*/
+int benchmarkStretch() {
+    static const double speeds[] = { 0.5, 2.0, 4.0 };
+    static struct APU apu;
+    static struct Stretch stretch;
+    static int16_t stretched[BLIP_SIZE * 4];
+    struct Scheduler scheduler;
+    const int frames = 36000;
+    int16_t *tune = malloc((size_t)frames * BLIP_SIZE * sizeof(int16_t));
+    int *lengths = malloc(frames * sizeof(int));
+    if (tune == NULL || lengths == NULL) {
+        printf("Could not allocate the benchmark tune\n");
+        free(tune);
+        free(lengths);
+        return 0;
+    }
+    startBenchmarkTune(&apu, &scheduler);
+    for (int frame = 0; frame < frames; frame++) {
+        lengths[frame] = playBenchmarkFrame(&apu, &scheduler, frame, tune + (size_t)frame * BLIP_SIZE);
+    }
+
+    for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+        stretch_init(&stretch, SAMPLE_RATE);
+        stretch_setSpeed(&stretch, speeds[i]);
+        long produced = 0;
+        clock_t start = clock();
+        for (int frame = 0; frame < frames; frame++) {
+            produced += stretch_process(&stretch, tune + (size_t)frame * BLIP_SIZE, lengths[frame], stretched, BLIP_SIZE * 4);
+        }
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+        double output = (double)produced / SAMPLE_RATE;
+        printf("%.1fx: %.0f seconds out, %.3f ms a second, %.0f times real time\n", speeds[i], output, seconds * 1000.0 / output, output / seconds);
+    }
+    free(tune);
+    free(lengths);
+    return 1;
+}
+
+
+/*
+    Fills a line for the compose check: random bytes, or every byte the
+    same for the edge cases, one pattern per round
+*/
+static void fillLine(uint8_t *line, int length, int round, uint32_t *seed) {
+    static const uint8_t fills[] = { 0x00, 0xFF, 0x03, 0x40, 0x43, 0x83, 0xC3, 0x1F };
+    for (int x = 0; x < length; x++) {
+        *seed ^= *seed << 13;
+        *seed ^= *seed >> 17;
+        *seed ^= *seed << 5;
+        line[x] = (round < (int)sizeof(fills)) ? fills[round] : (uint8_t)*seed;
+    }
+}
+
+/*
+    Checks every compose backend this CPU can run gives the same bytes as
+    the scalar kernels, over edge case and random lines at every fine X
+    and every combination of the clipping, show and greyscale bits
+*/
+int testCompose() {
+    static const uint8_t masks[] = { 0x00, 0x02, 0x04, 0x06, 0x08, 0x0A, 0x0C, 0x0E, 0x10, 0x12, 0x14, 0x16, 0x18, 0x1A, 0x1C, 0x1E, 0x1F };
+    uint8_t background[PPU_WIDTH + 16];
+    uint8_t sprites[PPU_WIDTH];
+    uint8_t palette[32];
+    uint8_t expected[PPU_WIDTH];
+    uint8_t actual[PPU_WIDTH];
+    uint32_t seed = 2463534242u;
+    const int rounds = 200;
+    int failures = 0;
+    int lines = 0;
+
+    for (const struct ComposeKernels **kernels = compose_available(); *kernels; kernels++) {
+        if (*kernels == &compose_scalar) {
+            continue;
+        }
+        int backendFailures = 0;
+        for (int round = 0; round < rounds; round++) {
+            fillLine(background, sizeof(background), round, &seed);
+            fillLine(sprites, sizeof(sprites), round, &seed);
+            fillLine(palette, sizeof(palette), rounds, &seed);
+            for (int fineX = 0; fineX < 8; fineX++) {
+                for (size_t m = 0; m < sizeof(masks); m++) {
+                    uint8_t greyscale = (masks[m] & 0x01) ? 0x30 : 0x3F;
+                    compose_scalar.merge(expected, background + fineX, sprites, masks[m]);
+                    (*kernels)->merge(actual, background + fineX, sprites, masks[m]);
+                    int same = memcmp(expected, actual, PPU_WIDTH) == 0;
+                    compose_scalar.palette(expected, background + fineX, palette, greyscale);
+                    (*kernels)->palette(actual, background + fineX, palette, greyscale);
+                    same &= memcmp(expected, actual, PPU_WIDTH) == 0;
+                    if (!same && backendFailures++ < 10) {
+                        printf("%s differs: round %d, fine X %d, mask %02x\n", (*kernels)->name, round, fineX, masks[m]);
+                    }
+                    lines++;
+                }
+            }
+        }
+        printf("%s: %s\n", (*kernels)->name, backendFailures ? "differs from scalar" : "matches scalar");
+        failures += backendFailures;
+    }
+    printf("%d lines checked, %d differ\n", lines, failures);
+    return failures == 0;
+}
+
+
+/*
+    The expansion check drives each chip's registers directly: a VRC6
+    pulse, a 5B tone and two N163 channels playing a square wave out of
+    RAM. catchUp makes an access that brings the chip up to date without
+    changing what it plays.
 */
-int main() {
-    FILE *rom = loadROM();
-    void* surface = GUI_getSurface(GUI_initialiseWindow()); 
+static void setUpChip(struct Expansion *expansion, uint8_t chip) {
+    static const uint8_t vrc6[][2] = { {0x00, 0x7F}, {0x01, 200}, {0x02, 0x80} };
+    static const uint8_t sunsoft[][2] = { {0, 0x00}, {1, 0x01}, {7, 0x3E}, {8, 0x0F} };
+    static const uint8_t namco[][2] = {
+        {0x7F, 0x1F}, {0x7E, 0x00}, {0x78, 0x00}, {0x7A, 0x40}, {0x7C, 0xE0},
+        {0x77, 0x3A}, {0x76, 0x00}, {0x70, 0x00}, {0x72, 0x70}, {0x74, 0xE0}
+    };
+    if (chip == EXPANSION_VRC6) {
+        for (size_t i = 0; i < sizeof(vrc6) / sizeof(vrc6[0]); i++) {
+            expansion_write(expansion, 0x9000 + vrc6[i][0], vrc6[i][1]);
+        }
+    }
+    else if (chip == EXPANSION_5B) {
+        for (size_t i = 0; i < sizeof(sunsoft) / sizeof(sunsoft[0]); i++) {
+            expansion_write(expansion, 0xC000, sunsoft[i][0]);
+            expansion_write(expansion, 0xE000, sunsoft[i][1]);
+        }
+    }
+    else {
+        for (int i = 0; i < 16; i++) {
+            expansion_write(expansion, 0xF800, i);
+            expansion_write(expansion, 0x4800, (i < 8) ? 0xFF : 0x00);
+        }
+        for (size_t i = 0; i < sizeof(namco) / sizeof(namco[0]); i++) {
+            expansion_write(expansion, 0xF800, namco[i][0]);
+            expansion_write(expansion, 0x4800, namco[i][1]);
+        }
+    }
+}
+
+static void catchUpChip(struct Expansion *expansion, uint8_t chip) {
+    if (chip == EXPANSION_VRC6) {
+        expansion_write(expansion, 0x9003, 0x00);
+    }
+    else if (chip == EXPANSION_5B) {
+        expansion_write(expansion, 0xC000, 14);
+        expansion_write(expansion, 0xE000, 0x00);
+    }
+    else {
+        expansion_write(expansion, 0xF800, 0x7F);
+        expansion_read(expansion, 0x4800);
+    }
+}
+
+/*
+    Plays frames of a chip into samples, catching it up touches times a
+    frame as well as at the end of each, and returns how many samples came
+    out
+*/
+static int playChip(uint8_t chip, int frames, int touches, int16_t *samples) {
+    static struct APU apu;
+    static struct Expansion expansion;
+    struct Scheduler scheduler;
+    scheduler_init(&scheduler);
+    apu_init(&apu, &scheduler, SAMPLE_RATE);
+    expansion_init(&expansion, &apu, chip);
+    setUpChip(&expansion, chip);
+
+    int count = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        uint64_t start = scheduler.now;
+        for (int touch = 1; touch <= touches; touch++) {
+            scheduler.now = start + (uint64_t)FRAME_CYCLES * CPU_DOTS * touch / (touches + 1);
+            catchUpChip(&expansion, chip);
+        }
+        scheduler.now = start + (uint64_t)FRAME_CYCLES * CPU_DOTS;
+        apu_endFrame(&apu);
+        count += apu_readSamples(&apu, samples + count, BLIP_SIZE);
+    }
+    return count;
+}
+
+/*
+    The frequency within 5% of expected that samples are strongest at, in
+    quarter hertz steps
+*/
+static double strongestNear(const int16_t *samples, int count, double expected) {
+    const double pi = 3.14159265358979323846;
+    double strongest = 0.0;
+    double power = -1.0;
+    for (double frequency = expected * 0.95; frequency <= expected * 1.05; frequency += 0.25) {
+        double coefficient = 2.0 * cos(2.0 * pi * frequency / SAMPLE_RATE);
+        double previous = 0.0;
+        double older = 0.0;
+        for (int i = 0; i < count; i++) {
+            double current = samples[i] + coefficient * previous - older;
+            older = previous;
+            previous = current;
+        }
+        double bin = previous * previous + older * older - coefficient * previous * older;
+        if (bin > power) {
+            power = bin;
+            strongest = frequency;
+        }
+    }
+    return strongest;
+}
+
+/*
+    Checks each expansion chip plays at the pitch its registers ask for,
+    and that catching it up hundreds of times a frame gives exactly the
+    samples catching it up once a frame does
+*/
+int testExpansion() {
+    static const struct {
+        const char *name;
+        uint8_t chip;
+        double pitches[2];
+    } chips[] = {
+        { "vrc6", EXPANSION_VRC6, { APU_CLOCK_RATE / 16 / 201, 0 } },
+        { "5b", EXPANSION_5B, { APU_CLOCK_RATE / 32 / 256, 0 } },
+        { "n163", EXPANSION_N163, { APU_CLOCK_RATE * 0x4000 / (15.0 * 2 * 32 * 65536), APU_CLOCK_RATE * 0x7000 / (15.0 * 2 * 32 * 65536) } }
+    };
+    const int frames = 120;
+    int16_t *coarse = malloc((size_t)frames * BLIP_SIZE * sizeof(int16_t));
+    int16_t *fine = malloc((size_t)frames * BLIP_SIZE * sizeof(int16_t));
+    if (coarse == NULL || fine == NULL) {
+        free(coarse);
+        free(fine);
+        return 0;
+    }
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(chips) / sizeof(chips[0]); i++) {
+        int count = playChip(chips[i].chip, frames, 0, coarse);
+        int fineCount = playChip(chips[i].chip, frames, 333, fine);
+        int same = (count == fineCount) && memcmp(coarse, fine, count * sizeof(int16_t)) == 0;
+        printf("%s: catching up 333 times a frame %s\n", chips[i].name, same ? "matches once a frame" : "differs from once a frame");
+        failures += !same;
+        for (int p = 0; p < 2 && chips[i].pitches[p] > 0; p++) {
+            double heard = strongestNear(coarse, count, chips[i].pitches[p]);
+            int near = fabs(heard - chips[i].pitches[p]) <= 1.0;
+            printf("%s: expected %.1f Hz, strongest at %.2f Hz\n", chips[i].name, chips[i].pitches[p], heard);
+            failures += !near;
+        }
+    }
+    free(coarse);
+    free(fine);
+    printf("%d checks failed\n", failures);
+    return failures == 0;
+}
+
+
+/*
+    Prints a line of running totals about once a second of emulation
+*/
+void reportStats(const struct AudioSink *sink, int frame, double ratio) {
+    if (frame % 60 != 0) {
+        return;
+    }
+    struct AudioStats audio;
+    sink->stats(&audio);
+    printf("frame %d: audio %u samples queued, %u underruns, %u overruns, %u pacing timeouts, rate %+.3f%%\n", frame, audio.fill, audio.underruns, audio.overruns, audio.paceTimeouts, (ratio - 1.0) * 100.0);
+}
+
+
+/*
+    Writes a picture to prefix followed by its frame number as a PGM of
+    its NES colour numbers, 0-63
+*/
+int writeFrame(const char *prefix, int frame, const uint8_t *pixels) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s%06d.pgm", prefix, frame);
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return 0;
+    }
+    fprintf(file, "P5 %d %d 63\n", PPU_WIDTH, PPU_HEIGHT);
+    fwrite(pixels, 1, PPU_WIDTH * PPU_HEIGHT, file);
+    return fclose(file) == 0;
+}
+
+/*
+    Runs a ROM without a window for frames frames on one PPU, keeping a
+    hash of every finished frame and passing the sound to sink if there is
+    one. options, if given, can skip frames, move the scanline renderer
+    onto its own thread and name a --frames-out prefix every interval'th
+    frame and the last are written out to. A skipped frame keeps the hash
+    of the one before it. rom is left where it started.
+*/
+int runHeadless(FILE *rom, enum PPUCore core, int frames, uint32_t *hashes, const struct AudioSink *sink, const struct Options *options) {
+    static struct Cartridge cartridge;
+    static struct PPU ppu;
+    static struct APU apu;
+    static int16_t samples[BLIP_SIZE];
     struct NES consoleState = {0};
-    
+    long start = ftell(rom);
+    scheduler_init(&consoleState.scheduler);
+    if (!cartridge_load(&cartridge, rom)) {
+        return 0;
+    }
+    if (!ppu_init(&ppu, &consoleState.scheduler, cartridge.chr, cartridge.chrSize, cartridge.mirroring)) {
+        cartridge_free(&cartridge);
+        return 0;
+    }
+    fseek(rom, start, SEEK_SET);
+    ppu_setCore(&ppu, core);
+    const char *framesOut = NULL;
+    int interval = FRAME_INTERVAL;
+    if (options != NULL) {
+        framesOut = options->framesOut;
+        interval = (options->frameInterval > 0) ? options->frameInterval : FRAME_INTERVAL;
+        ppu_setFrameSkip(&ppu, options->frameSkip);
+        if (core == PPU_CORE_SCANLINE && options->renderThread && !ppu_startThread(&ppu)) {
+            fprintf(stderr, "Could not start the render thread, rendering on the CPU thread\n");
+        }
+    }
+    apu_init(&apu, &consoleState.scheduler, SAMPLE_RATE);
+    cartridge.ppu = &ppu;
+    consoleState.ppu = &ppu;
+    consoleState.apu = &apu;
+    consoleState.cartridge = &cartridge;
+    memory_connect(&consoleState);
+    cpu_reset(&consoleState);
+
+    uint32_t hash = 2166136261u;
+    for (int frame = 0; frame < frames; frame++) {
+        cpu_execute(&consoleState);
+        apu_endFrame(&apu);
+        int count = apu_readSamples(&apu, samples, BLIP_SIZE);
+        if (sink != NULL) {
+            sink->write(samples, count);
+        }
+        const uint8_t *pixels;
+        const uint8_t *emphasis;
+        int shown = ppu_output(&ppu, &pixels, &emphasis);
+        if (shown) {
+            hash = 2166136261u;
+            for (int i = 0; i < PPU_WIDTH * PPU_HEIGHT; i++) {
+                hash = (hash ^ pixels[i]) * 16777619u;
+            }
+            for (int i = 0; i < PPU_HEIGHT; i++) {
+                hash = (hash ^ emphasis[i]) * 16777619u;
+            }
+        }
+        hashes[frame] = hash;
+        if (framesOut != NULL && shown && ((frame + 1) % interval == 0 || frame + 1 == frames) && !writeFrame(framesOut, frame + 1, pixels)) {
+            fprintf(stderr, "Could not write frame %d to %s\n", frame + 1, framesOut);
+            framesOut = NULL;
+        }
+    }
+    ppu_free(&ppu);
+    cartridge_free(&cartridge);
+    return 1;
+}
+
+/*
+    Runs the ROM on both PPUs and reports the frames they draw differently.
+    Only meaningful for games the scanline PPU handles.
+*/
+int differentialPPU(FILE *rom, int frames) {
+    uint32_t *hashes[2] = { malloc(frames * sizeof(uint32_t)), malloc(frames * sizeof(uint32_t)) };
+    if (hashes[0] == NULL || hashes[1] == NULL || !runHeadless(rom, PPU_CORE_SCANLINE, frames, hashes[0], NULL, NULL) || !runHeadless(rom, PPU_CORE_DOT, frames, hashes[1], NULL, NULL)) {
+        printf("Could not load ROM!\n");
+        exit(1);
+    }
+    int differences = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        if (hashes[0][frame] != hashes[1][frame]) {
+            if (differences++ < 10) {
+                printf("frame %d differs\n", frame);
+            }
+        }
+    }
+    printf("%d of %d frames differ between the scanline and dot PPUs\n", differences, frames);
+    free(hashes[0]);
+    free(hashes[1]);
+    return differences == 0;
+}
+
+
+/*
+    Runs the ROM for the --headless number of frames as fast as it will go
+    with the sound going to the file sink, then reports the speed and
+    hashes of the last picture and of all the sound for checking against
+    earlier runs, also to the --stats-out file if there is one. Fails
+    without reporting if the sound could not all be written
+*/
+int runBatch(FILE *rom, enum PPUCore core, const struct Options *options) {
+    int frames = options->headlessFrames;
+    uint32_t *hashes = malloc(frames * sizeof(uint32_t));
+    audiofile_setPath(options->audioOut);
+    if (hashes == NULL || !audiofile_sink.open(SAMPLE_RATE)) {
+        return 0;
+    }
+    clock_t start = clock();
+    int loaded = runHeadless(rom, core, frames, hashes, &audiofile_sink, options);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    int closed = audiofile_sink.close();
+    if (!loaded) {
+        fprintf(stderr, "Could not load ROM!\n");
+        free(hashes);
+        return 0;
+    }
+    if (!closed) {
+        free(hashes);
+        return 0;
+    }
+    fprintf(stderr, "%d frames in %.3f s (%.1f fps), frame hash %08x, audio hash %08x\n", frames, seconds, frames / seconds, hashes[frames - 1], audiofile_hash());
+    int ok = 1;
+    if (options->statsOut != NULL) {
+        FILE *stats = fopen(options->statsOut, "w");
+        if (stats != NULL) {
+            fprintf(stats, "frames %d\nseconds %.3f\nfps %.1f\nframe_hash %08x\naudio_hash %08x\n", frames, seconds, frames / seconds, hashes[frames - 1], audiofile_hash());
+        }
+        if (stats == NULL || fclose(stats) != 0) {
+            fprintf(stderr, "Could not write %s\n", options->statsOut);
+            ok = 0;
+        }
+    }
+    free(hashes);
+    return ok;
+}
+
+
+/*
+    Renders seconds of one song of an NSF into the file sink at path, as
+    fast as it will go. A NULL path only hashes the sound, so rendering
+    several songs with no --audio-out checks them without leaving any
+    files. Fails without a hash if the file could not all be written
+*/
+int renderTrack(struct NSF *nsf, int song, int seconds, const char *path) {
+    static struct NSFPlayer player;
+    static int16_t samples[BLIP_SIZE];
+    audiofile_setPath(path);
+    if (!audiofile_sink.open(SAMPLE_RATE)) {
+        return 0;
+    }
+    clock_t start = clock();
+    nsf_start(&player, nsf, song, SAMPLE_RATE);
+    uint64_t total = (uint64_t)seconds * (uint64_t)APU_CLOCK_RATE;
+    for (uint64_t done = 0; done < total; done += FRAME_CYCLES) {
+        nsf_run(&player, FRAME_CYCLES);
+        apu_endFrame(&player.apu);
+        audiofile_sink.write(samples, apu_readSamples(&player.apu, samples, BLIP_SIZE));
+    }
+    double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (!audiofile_sink.close()) {
+        return 0;
+    }
+    fprintf(stderr, "song %d: %d s in %.3f s, %.0f times real time, audio hash %08x\n", song, seconds, elapsed, seconds / elapsed, audiofile_hash());
+    return 1;
+}
+
+/*
+    Where one of several songs goes: the output path with the song number
+    before its extension, so out.wav becomes out-03.wav. Returns 0 rather
+    than cut short a path that doesn't fit in size
+*/
+int trackPath(char *out, size_t size, const char *path, int song) {
+    const char *end = path + strlen(path);
+    for (const char *c = path; *c; c++) {
+        if (*c == '.') {
+            end = c;
+        }
+        else if (*c == '/' || *c == '\\') {
+            end = path + strlen(path);
+        }
+    }
+    int length = snprintf(out, size, "%.*s-%02d%s", (int)(end - path), path, song, end);
+    if (length < 0 || (size_t)length >= size) {
+        fprintf(stderr, "Path too long: %s\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+int cpuCount() {
+#ifdef _WIN32
+    const char *count = getenv("NUMBER_OF_PROCESSORS");
+    return (count != NULL && atoi(count) > 0) ? atoi(count) : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+#endif
+}
+
+/*
+    Child processes each rendering one song. Windows can't fork, so there
+    the program is run again for just that song.
+*/
+#ifdef _WIN32
+typedef intptr_t Job;
+
+/*
+    _spawnv joins its arguments into one command line, so paths with
+    spaces in have to be quoted. Returns 0 rather than cut one short.
+*/
+int quotePath(char *out, size_t size, const char *path) {
+    int length = snprintf(out, size, "\"%s\"", path);
+    if (length < 0 || (size_t)length >= size) {
+        fprintf(stderr, "Path too long: %s\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+Job startTrack(const struct Options *options, struct NSF *nsf, int song, const char *path) {
+    char nsfPath[280];
+    char outPath[280];
+    char track[16];
+    char seconds[16];
+    if (!quotePath(nsfPath, sizeof(nsfPath), options->nsfPath)) {
+        return -1;
+    }
+    if (path != NULL && !quotePath(outPath, sizeof(outPath), path)) {
+        return -1;
+    }
+    snprintf(track, sizeof(track), "%d", song);
+    snprintf(seconds, sizeof(seconds), "%d", options->seconds);
+    const char *args[] = { options->program, "--nsf", nsfPath, "--track", track, "--seconds", seconds, "--jobs", "1", (path != NULL) ? "--audio-out" : NULL, (path != NULL) ? outPath : NULL, NULL };
+    return _spawnv(_P_NOWAIT, options->program, args);
+}
+
+int finishTrack(Job job) {
+    int status = 1;
+    return _cwait(&status, job, _WAIT_CHILD) != -1 && status == 0;
+}
+#else
+typedef pid_t Job;
+
+Job startTrack(const struct Options *options, struct NSF *nsf, int song, const char *path) {
+    fflush(stdout);
+    fflush(stderr);
+    Job job = fork();
+    if (job == 0) {
+        exit(renderTrack(nsf, song, options->seconds, path) ? 0 : 1);
+    }
+    return job;
+}
+
+int finishTrack(Job job) {
+    int status = 1;
+    return waitpid(job, &status, 0) == job && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+#endif
+
+/*
+    Renders songs first to last. The bus only has room for one machine, so
+    songs are rendered side by side in up to jobs child processes, each
+    into its own file. Standard output can only take one song at a time.
+*/
+int renderTracks(const struct Options *options, struct NSF *nsf, int first, int last) {
+    const char *path = options->audioOut;
+    int several = (first != last);
+    int toStdout = (path != NULL && strcmp(path, "-") == 0);
+    int jobs = (options->jobs < MAX_JOBS) ? options->jobs : MAX_JOBS;
+    char songPath[280];
+    int ok = 1;
+    if (!several || jobs <= 1 || toStdout) {
+        for (int song = first; song <= last; song++) {
+            const char *out = path;
+            if (several && path != NULL && !toStdout) {
+                if (!trackPath(songPath, sizeof(songPath), path, song)) {
+                    ok = 0;
+                    continue;
+                }
+                out = songPath;
+            }
+            ok &= renderTrack(nsf, song, options->seconds, out);
+        }
+        return ok;
+    }
+
+    Job running[MAX_JOBS];
+    int oldest = 0;
+    int count = 0;
+    for (int song = first; song <= last; song++) {
+        if (count == jobs) {
+            ok &= finishTrack(running[oldest]);
+            oldest = (oldest + 1) % jobs;
+            count--;
+        }
+        if (path != NULL && !trackPath(songPath, sizeof(songPath), path, song)) {
+            ok = 0;
+            continue;
+        }
+        Job job = startTrack(options, nsf, song, (path != NULL) ? songPath : NULL);
+        if (job == -1) {
+            ok = 0;
+            continue;
+        }
+        running[(oldest + count) % jobs] = job;
+        count++;
+    }
+    while (count) {
+        ok &= finishTrack(running[oldest]);
+        oldest = (oldest + 1) % jobs;
+        count--;
+    }
+    return ok;
+}
+
+/*
+    Renders the NSF's songs, or just the one asked for, with no window
+*/
+int playNSF(const struct Options *options) {
+    static struct NSF nsf;
+    FILE *file = fopen(options->nsfPath, "rb");
+    if (file == NULL || !nsf_load(&nsf, file)) {
+        fprintf(stderr, "Could not load %s\n", options->nsfPath);
+        return 0;
+    }
+    fclose(file);
+    fprintf(stderr, "%s - %s (%s), %d songs\n", nsf.title, nsf.artist, nsf.copyright, nsf.songs);
+    if (nsf.chips & ~EXPANSION_CHIPS) {
+        fprintf(stderr, "VRC7, FDS and MMC5 sound is not played\n");
+    }
+    if (options->track < 0 || options->track > nsf.songs) {
+        fprintf(stderr, "There is no song %d\n", options->track);
+        nsf_free(&nsf);
+        return 0;
+    }
+    int first = options->track ? options->track : 1;
+    int last = options->track ? options->track : nsf.songs;
+    int ok = renderTracks(options, &nsf, first, last);
+    nsf_free(&nsf);
+    return ok;
+}
+
+
+#ifndef PINES_HEADLESS
+/*
+    Presents a synthetic frame using every colour and emphasis in both
+    output modes
+*/
+int benchmarkPresent() {
+    static uint8_t colours[PPU_WIDTH * PPU_HEIGHT];
+    uint8_t emphasis[PPU_HEIGHT];
+    for (int y = 0; y < PPU_HEIGHT; y++) {
+        for (int x = 0; x < PPU_WIDTH; x++) {
+            colours[y * PPU_WIDTH + x] = (x / 4 + y) & 0x3F;
+        }
+        emphasis[y] = (y / 30) & 0x07;
+    }
+    GUI_benchmarkPresent(colours, emphasis, 600);
+    GUI_stopSDL();
+    return 1;
+}
+
+
+/*
+    Plays the ROM in a window until it is closed. Vsync paces the loop when
+    it can; the sink's pace is only used when vsync is unavailable, turned
+    off with --no-vsync, or when --speed is not 1
+*/
+int playWindowed(const struct Options *options, FILE *rom) {
+    static struct Cartridge cartridge;
+    static struct PPU ppu;
+    static struct APU apu;
+    static struct Stretch stretch;
+    static int16_t samples[BLIP_SIZE];
+    static int16_t stretched[BLIP_SIZE * 4];
+    struct NES consoleState = {0};
+    scheduler_init(&consoleState.scheduler);
+    if (!cartridge_load(&cartridge, rom) || !ppu_init(&ppu, &consoleState.scheduler, cartridge.chr, cartridge.chrSize, cartridge.mirroring)) {
+        printf("Could not load ROM!\n");
+        exit(1);
+    }
+    fclose(rom);
+    cartridge.ppu = &ppu;
+    ppu_setFrameSkip(&ppu, options->frameSkip);
+    if (options->core == PPU_CORE_DOT) {
+        ppu_setCore(&ppu, PPU_CORE_DOT);
+    }
+    else if (options->renderThread && !ppu_startThread(&ppu)) {
+        printf("Could not start the render thread, rendering on the CPU thread\n");
+    }
+
+    SDL_Window *window = GUI_initialiseWindow();
+    int vsync = GUI_initialiseOutput(window, options->rgb565, !options->noVsync && options->speed == 1.0);
+    const struct AudioSink *sink = &GUI_audioSink;
+    if (options->audioOut != NULL) {
+        audiofile_setPath(options->audioOut);
+        sink = &audiofile_sink;
+    }
+    int sampleRate = sink->open(SAMPLE_RATE);
+    int audio = (sampleRate != 0);
+    if (!audio) {
+        printf("Could not open audio, running without sound\n");
+        sampleRate = SAMPLE_RATE;
+    }
+    apu_init(&apu, &consoleState.scheduler, sampleRate);
+    stretch_init(&stretch, sampleRate);
+    stretch_setSpeed(&stretch, options->speed);
+    struct RateControl rate;
+    ratecontrol_init(&rate, sampleRate / 20);
+    consoleState.surface = (options->rgb565 || vsync) ? NULL : GUI_getSurface(window);
+    consoleState.ppu = &ppu;
+    consoleState.apu = &apu;
+    consoleState.cartridge = &cartridge;
+    memory_connect(&consoleState);
+    cpu_reset(&consoleState);
+
+    for (int frame = 1; !GUI_pollQuit(); frame++) {
+        cpu_execute(&consoleState);
+        apu_endFrame(&apu);
+        int count = apu_readSamples(&apu, samples, BLIP_SIZE);
+        sink->write(stretched, stretch_process(&stretch, samples, count, stretched, BLIP_SIZE * 4));
+        if (audio && sink->realtime) {
+            struct AudioStats stats;
+            sink->stats(&stats);
+            apu_setSampleRate(&apu, sampleRate * ratecontrol_update(&rate, stats.fill));
+        }
+        const uint8_t *pixels;
+        const uint8_t *emphasis;
+        if (ppu_output(&ppu, &pixels, &emphasis)) {
+            GUI_presentFrame(window, pixels, emphasis);
+        }
+        if (!vsync) {
+            sink->pace(rate.target);
+        }
+        if (options->stats) {
+            reportStats(sink, frame, rate.ratio);
+        }
+    }
+    ppu_free(&ppu);
+    int closed = sink->close();
+    GUI_closeOutput();
+    GUI_closeWindow(window);
+    GUI_stopSDL();
+    return closed;
+}
+#else
+/*
+    Built without SDL, so only the modes that need no window can run
+*/
+int benchmarkPresent() {
+    fprintf(stderr, "This build has no window\n");
     return 0;
-}
\ No newline at end of file
+}
+
+int playWindowed(const struct Options *options, FILE *rom) {
+    fprintf(stderr, "This build has no window, run with --headless or --nsf\n");
+    fclose(rom);
+    return 0;
+}
+#endif
+
+
+/*
+    Entry point into the program
+*/
+int main(int argc, char *argv[]) {
+    struct Options options = {0};
+    options.core = -1;
+    options.seconds = 150;
+    options.speed = 1.0;
+    options.program = argv[0];
+    parseOptions(argc, argv, &options);
+    if (options.jobs <= 0) {
+        options.jobs = cpuCount();
+    }
+    if (options.benchmarkPresent) {
+        return benchmarkPresent() ? 0 : 1;
+    }
+    if (options.benchmarkAudio) {
+        benchmarkAudio();
+        return 0;
+    }
+    if (options.benchmarkStretch) {
+        return benchmarkStretch() ? 0 : 1;
+    }
+    if (options.testCompose) {
+        return testCompose() ? 0 : 1;
+    }
+    if (options.testExpansion) {
+        return testExpansion() ? 0 : 1;
+    }
+    if (options.nsfPath != NULL) {
+        return playNSF(&options) ? 0 : 1;
+    }
+
+    char name[256];
+    FILE *rom = (options.romPath != NULL) ? openROM(options.romPath, name) : loadROM(name);
+    if (rom == NULL) {
+        fprintf(stderr, "Could not open %s\n", options.romPath);
+        exit(1);
+    }
+    compose_init();
+    if (options.diffFrames > 0) {
+        return differentialPPU(rom, options.diffFrames) ? 0 : 1;
+    }
+    if (options.core < 0) {
+        options.core = catalogueCore(name);
+    }
+    if (options.headlessFrames > 0) {
+        return runBatch(rom, (options.core == PPU_CORE_DOT) ? PPU_CORE_DOT : PPU_CORE_SCANLINE, &options) ? 0 : 1;
+    }
+    return playWindowed(&options, rom) ? 0 : 1;
+}
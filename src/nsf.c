@@ -0,0 +1,194 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./headers/nsf.h"
+#include "./headers/apu.h"
+#include "./headers/cartridge.h"
+#include "./headers/interpreter.h"
+#include "./headers/memory.h"
+#include "./headers/scheduler.h"
+
+#define HEADER_SIZE 0x80
+#define DEFAULT_SPEED 16639
+#define INIT_LIMIT 1789773
+
+/*
+    Routines are called with this address, minus one, pushed as the return
+    address. Nothing is mapped there, so the CPU reaching it means the
+    routine has returned.
+*/
+#define RETURN_ADDRESS 0x4F80
+
+
+/* -------
+    Loading
+    ------ */
+static void copyString(char *out, const uint8_t *field) {
+    memcpy(out, field, 32);
+    out[32] = '\0';
+}
+
+/*
+    Reads an NSF from the start of file. A rip that never writes a bank
+    number is laid out as 32KB from $8000. A bankswitched one is cut into
+    4KB banks counting from the 4KB boundary below its load address.
+*/
+int nsf_load(struct NSF *nsf, FILE *file) {
+    uint8_t header[HEADER_SIZE];
+    memset(nsf, 0, sizeof(struct NSF));
+    if (fread(header, 1, HEADER_SIZE, file) != HEADER_SIZE || memcmp(header, "NESM\x1A", 5) != 0) {
+        return 0;
+    }
+    nsf->songs = header[0x06];
+    nsf->firstSong = header[0x07] ? header[0x07] : 1;
+    nsf->load = header[0x08] | (header[0x09] << 8);
+    nsf->init = header[0x0A] | (header[0x0B] << 8);
+    nsf->play = header[0x0C] | (header[0x0D] << 8);
+    copyString(nsf->title, header + 0x0E);
+    copyString(nsf->artist, header + 0x2E);
+    copyString(nsf->copyright, header + 0x4E);
+    nsf->speed = header[0x6E] | (header[0x6F] << 8);
+    if (nsf->speed == 0) {
+        nsf->speed = DEFAULT_SPEED;
+    }
+    for (int i = 0; i < 8; i++) {
+        nsf->banks[i] = header[0x70 + i];
+        nsf->bankswitched |= (header[0x70 + i] != 0);
+    }
+    nsf->chips = header[0x7B];
+
+    long start = ftell(file);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file) - start;
+    fseek(file, start, SEEK_SET);
+    if (size <= 0 || (!nsf->bankswitched && nsf->load < 0x8000)) {
+        return 0;
+    }
+
+    struct Cartridge *cartridge = &nsf->cartridge;
+    uint32_t offset = nsf->bankswitched ? (nsf->load & 0x0FFF) : (uint32_t)(nsf->load - 0x8000);
+    cartridge->prgSize = nsf->bankswitched ? ((offset + size + 0x0FFF) & ~0x0FFF) : 0x8000;
+    if (!nsf->bankswitched && offset + size > cartridge->prgSize) {
+        size = cartridge->prgSize - offset;
+    }
+    cartridge->prg = calloc(cartridge->prgSize, 1);
+    cartridge->prgRam = calloc(0x2000, 1);
+    cartridge->mapper = MAPPER_NSF;
+    if (cartridge->prg == NULL || cartridge->prgRam == NULL || fread(cartridge->prg + offset, 1, size, file) != (size_t)size) {
+        cartridge_free(cartridge);
+        return 0;
+    }
+    return 1;
+}
+
+void nsf_free(struct NSF *nsf) {
+    cartridge_free(&nsf->cartridge);
+}
+
+
+/* --------
+    Playing
+    ------- */
+
+/*
+    Sets the CPU off into a routine as if it had been called with JSR
+*/
+static void call(struct NSFPlayer *player, uint16_t routine) {
+    struct NES *nes = &player->nes;
+    uint16_t back = RETURN_ADDRESS - 1;
+    cpu_write(0x0100 + nes->stackPointer--, back >> 8);
+    cpu_write(0x0100 + nes->stackPointer--, back & 0xFF);
+    nes->programCounter = routine;
+}
+
+/*
+    The dot the next PLAY is due on, worked out from the start each time so
+    a speed that isn't a whole number of cycles doesn't drift
+*/
+static uint64_t nextPlay(const struct NSFPlayer *player) {
+    uint64_t cycles = (player->plays + 1) * player->nsf->speed * (uint64_t)APU_CLOCK_RATE / 1000000;
+    return player->playStart + cycles * CPU_DOTS;
+}
+
+static void handlePlay(void *context, enum Event event) {
+    struct NSFPlayer *player = (struct NSFPlayer*)context;
+    player->playDue = 1;
+    player->plays++;
+    scheduler_schedule(&player->nes.scheduler, EVENT_NSF_PLAY, nextPlay(player));
+}
+
+/*
+    Powers up a fresh machine for song, counting from 1, and runs its INIT.
+    An INIT that hasn't returned after a second is left running, and PLAY
+    is only started once it does. Only NTSC timing is played. The sound
+    chips the rip lists are powered up with it, those that are emulated.
+*/
+void nsf_start(struct NSFPlayer *player, struct NSF *nsf, int song, int sampleRate) {
+    struct NES *nes = &player->nes;
+    memset(nes, 0, sizeof(struct NES));
+    player->nsf = nsf;
+    player->plays = 0;
+    player->playDue = 0;
+    scheduler_init(&nes->scheduler);
+    apu_init(&player->apu, &nes->scheduler, sampleRate);
+    nsf->cartridge.expansion = NULL;
+    if (nsf->chips & EXPANSION_CHIPS) {
+        expansion_init(&player->expansion, &player->apu, nsf->chips);
+        nsf->cartridge.expansion = &player->expansion;
+    }
+    nes->apu = &player->apu;
+    nes->cartridge = &nsf->cartridge;
+    memory_connect(nes);
+    memset(nsf->cartridge.prgRam, 0, 0x2000);
+    for (int window = 0; window < 8; window++) {
+        cartridge_mapPrg(&nsf->cartridge, window, nsf->bankswitched ? nsf->banks[window] : (uint32_t)window);
+    }
+    for (uint16_t address = 0x4000; address < 0x4014; address++) {
+        cpu_write(address, 0);
+    }
+    cpu_write(0x4015, 0x0F);
+    cpu_write(0x4017, 0x40);
+
+    nes->stackPointer = 0xFD;
+    nes->statusRegister.i = 1;
+    nes->statusRegister.u = 1;
+    nes->accumulatorRegister = song - 1;
+    nes->xRegister = 0;
+    call(player, nsf->init);
+    uint64_t limit = nes->scheduler.now + (uint64_t)INIT_LIMIT * CPU_DOTS;
+    while (nes->programCounter != RETURN_ADDRESS && nes->scheduler.now < limit) {
+        cpu_step(nes);
+    }
+
+    player->playStart = nes->scheduler.now;
+    scheduler_setHandler(&nes->scheduler, EVENT_NSF_PLAY, &handlePlay, player);
+    scheduler_schedule(&nes->scheduler, EVENT_NSF_PLAY, nextPlay(player));
+}
+
+/*
+    Plays on for cycles CPU cycles. A PLAY that comes due while the last
+    one is still running waits for it to return.
+*/
+void nsf_run(struct NSFPlayer *player, uint32_t cycles) {
+    struct NES *nes = &player->nes;
+    struct Scheduler *scheduler = &nes->scheduler;
+    uint64_t end = scheduler->now + (uint64_t)cycles * CPU_DOTS;
+    while (scheduler->now < end) {
+        if (nes->programCounter != RETURN_ADDRESS) {
+            cpu_step(nes);
+        }
+        else if (player->playDue) {
+            player->playDue = 0;
+            call(player, player->nsf->play);
+        }
+        else {
+            scheduler->now = (scheduler->next < end) ? scheduler->next : end;
+            scheduler->now += (CPU_DOTS - scheduler->now % CPU_DOTS) % CPU_DOTS;
+            if (scheduler->next <= scheduler->now) {
+                scheduler_run(scheduler);
+            }
+        }
+    }
+}
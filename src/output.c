@@ -0,0 +1,204 @@
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "./headers/output.h"
+
+
+/*
+    2C02 colours as 0xRRGGBB
+*/
+static const uint32_t nesPalette[64] = {
+    0x666666, 0x002A88, 0x1412A7, 0x3B00A4, 0x5C007E, 0x6E0040, 0x6C0600, 0x561D00,
+    0x333500, 0x0B4800, 0x005200, 0x004F08, 0x00404D, 0x000000, 0x000000, 0x000000,
+    0xADADAD, 0x155FD9, 0x4240FF, 0x7527FE, 0xA01ACC, 0xB71E7B, 0xB53120, 0x994E00,
+    0x6B6D00, 0x388700, 0x0C9300, 0x008F32, 0x007C8D, 0x000000, 0x000000, 0x000000,
+    0xFFFEFF, 0x64B0FF, 0x9290FF, 0xC676FF, 0xF36AFF, 0xFE6ECC, 0xFE8170, 0xEA9E22,
+    0xBCBE00, 0x88D800, 0x5CE430, 0x45E082, 0x48CDDE, 0x4F4F4F, 0x000000, 0x000000,
+    0xFFFEFF, 0xC0DFFF, 0xD3D2FF, 0xE8C8FF, 0xFBC2FF, 0xFEC4EA, 0xFECCC5, 0xF7D8A5,
+    0xE4E594, 0xCFEF96, 0xBDF4AB, 0xB3F3CC, 0xB5EBF2, 0xB8B8B8, 0x000000, 0x000000
+};
+
+static uint32_t packChannel(uint32_t value, uint32_t mask) {
+    if (mask == 0) {
+        return 0;
+    }
+    int shift = __builtin_ctz(mask);
+    int bits = __builtin_popcount(mask);
+    return ((bits >= 8) ? (value << (bits - 8)) : (value >> (8 - bits))) << shift;
+}
+
+
+/* -----------------
+    Scalar Converters
+    ---------------- */
+static void convert32(const struct Output *output, uint8_t *dst, const uint8_t *colours, uint8_t emphasis) {
+    const uint32_t *table = output->table[emphasis];
+    uint32_t *row = (uint32_t *)dst;
+    for (int x = 0; x < OUTPUT_WIDTH; x++) {
+        row[x] = table[colours[x]];
+    }
+}
+
+static void convert16(const struct Output *output, uint8_t *dst, const uint8_t *colours, uint8_t emphasis) {
+    const uint32_t *table = output->table[emphasis];
+    uint16_t *row = (uint16_t *)dst;
+    for (int x = 0; x < OUTPUT_WIDTH; x++) {
+        row[x] = (uint16_t)table[colours[x]];
+    }
+}
+
+static void convert24(const struct Output *output, uint8_t *dst, const uint8_t *colours, uint8_t emphasis) {
+    const uint32_t *table = output->table[emphasis];
+    for (int x = 0; x < OUTPUT_WIDTH; x++) {
+        uint32_t pixel = table[colours[x]];
+        dst[x * 3] = pixel & 0xFF;
+        dst[x * 3 + 1] = (pixel >> 8) & 0xFF;
+        dst[x * 3 + 2] = (pixel >> 16) & 0xFF;
+    }
+}
+
+
+/* -----------------
+    Vector Converters
+    ---------------- */
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void convert32_avx2(const struct Output *output, uint8_t *dst, const uint8_t *colours, uint8_t emphasis) {
+    const int *table = (const int *)output->table[emphasis];
+    for (int x = 0; x < OUTPUT_WIDTH; x += 8) {
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(colours + x)));
+        _mm256_storeu_si256((__m256i *)(dst + x * 4), _mm256_i32gather_epi32(table, index, 4));
+    }
+}
+
+__attribute__((target("avx2")))
+static void convert16_avx2(const struct Output *output, uint8_t *dst, const uint8_t *colours, uint8_t emphasis) {
+    const int *table = (const int *)output->table[emphasis];
+    for (int x = 0; x < OUTPUT_WIDTH; x += 16) {
+        __m256i low = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(colours + x)));
+        __m256i high = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(colours + x + 8)));
+        low = _mm256_i32gather_epi32(table, low, 4);
+        high = _mm256_i32gather_epi32(table, high, 4);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(low, high), 0xD8);
+        _mm256_storeu_si256((__m256i *)(dst + x * 2), packed);
+    }
+}
+#endif
+
+/*
+    vqtbl4q looks up 16 colours in a 64 byte table at once, one table per
+    byte of the pixel, and vst4q/vst2q interleave the bytes back into pixels
+*/
+#if defined(__aarch64__)
+static uint8x16x4_t loadPlane(const uint8_t *plane) {
+    uint8x16x4_t table;
+    table.val[0] = vld1q_u8(plane);
+    table.val[1] = vld1q_u8(plane + 16);
+    table.val[2] = vld1q_u8(plane + 32);
+    table.val[3] = vld1q_u8(plane + 48);
+    return table;
+}
+
+static void convert32_neon(const struct Output *output, uint8_t *dst, const uint8_t *colours, uint8_t emphasis) {
+    const uint8_t (*planes)[64] = output->planes[emphasis];
+    uint8x16x4_t byte0 = loadPlane(planes[0]);
+    uint8x16x4_t byte1 = loadPlane(planes[1]);
+    uint8x16x4_t byte2 = loadPlane(planes[2]);
+    uint8x16x4_t byte3 = loadPlane(planes[3]);
+    for (int x = 0; x < OUTPUT_WIDTH; x += 16) {
+        uint8x16_t index = vld1q_u8(colours + x);
+        uint8x16x4_t pixels;
+        pixels.val[0] = vqtbl4q_u8(byte0, index);
+        pixels.val[1] = vqtbl4q_u8(byte1, index);
+        pixels.val[2] = vqtbl4q_u8(byte2, index);
+        pixels.val[3] = vqtbl4q_u8(byte3, index);
+        vst4q_u8(dst + x * 4, pixels);
+    }
+}
+
+static void convert16_neon(const struct Output *output, uint8_t *dst, const uint8_t *colours, uint8_t emphasis) {
+    const uint8_t (*planes)[64] = output->planes[emphasis];
+    uint8x16x4_t byte0 = loadPlane(planes[0]);
+    uint8x16x4_t byte1 = loadPlane(planes[1]);
+    for (int x = 0; x < OUTPUT_WIDTH; x += 16) {
+        uint8x16_t index = vld1q_u8(colours + x);
+        uint8x16x2_t pixels;
+        pixels.val[0] = vqtbl4q_u8(byte0, index);
+        pixels.val[1] = vqtbl4q_u8(byte1, index);
+        vst2q_u8(dst + x * 2, pixels);
+    }
+}
+#endif
+
+
+/* --------
+    Set up
+    ------- */
+
+/*
+    Builds the 64 x 8 emphasis tables for the format described by the masks
+    and picks the converter. Emphasis dims the two channels that are not
+    emphasised, bit 0 being red, 1 green and 2 blue.
+*/
+int output_init(struct Output *output, int bytesPerPixel, uint32_t rmask, uint32_t gmask, uint32_t bmask, uint32_t amask) {
+    if (bytesPerPixel < 2 || bytesPerPixel > 4) {
+        return 0;
+    }
+    output->bytesPerPixel = bytesPerPixel;
+    for (int emphasis = 0; emphasis < 8; emphasis++) {
+        for (int colour = 0; colour < 64; colour++) {
+            uint32_t rgb = nesPalette[colour];
+            uint32_t channels[3] = { (rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF };
+            for (int channel = 0; channel < 3 && emphasis && (colour & 0x0F) < 0x0E; channel++) {
+                if (!(emphasis & (1 << channel))) {
+                    channels[channel] = channels[channel] * 209 / 256;
+                }
+            }
+            uint32_t pixel = packChannel(channels[0], rmask) | packChannel(channels[1], gmask) | packChannel(channels[2], bmask) | amask;
+            output->table[emphasis][colour] = pixel;
+            for (int byte = 0; byte < 4; byte++) {
+                output->planes[emphasis][byte][colour] = (pixel >> (byte * 8)) & 0xFF;
+            }
+        }
+    }
+
+    if (bytesPerPixel == 4) {
+        output->name = "32 bit";
+        output->convertRow = &convert32;
+    }
+    else if (bytesPerPixel == 2) {
+        output->name = "16 bit";
+        output->convertRow = &convert16;
+    }
+    else {
+        output->name = "24 bit";
+        output->convertRow = &convert24;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && bytesPerPixel != 3) {
+        output->name = (bytesPerPixel == 4) ? "32 bit avx2" : "16 bit avx2";
+        output->convertRow = (bytesPerPixel == 4) ? &convert32_avx2 : &convert16_avx2;
+    }
+#endif
+#if defined(__aarch64__)
+    if (bytesPerPixel != 3) {
+        output->name = (bytesPerPixel == 4) ? "32 bit neon" : "16 bit neon";
+        output->convertRow = (bytesPerPixel == 4) ? &convert32_neon : &convert16_neon;
+    }
+#endif
+    return 1;
+}
+
+void output_convertFrame(const struct Output *output, uint8_t *dst, int pitch, const uint8_t *colours, const uint8_t *emphasis) {
+    for (int y = 0; y < OUTPUT_HEIGHT; y++) {
+        output->convertRow(output, dst + y * pitch, colours + y * OUTPUT_WIDTH, emphasis[y]);
+    }
+}
@@ -0,0 +1,902 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./headers/ppu.h"
+#include "./headers/compose.h"
+#include "./headers/tilecache.h"
+#include "./headers/ppufetch.h"
+#include "./headers/ppudot.h"
+#include "./headers/ppulog.h"
+#include "./headers/pputhread.h"
+#include "./headers/bglayer.h"
+
+/*
+    The two dots each line changes v on, Y being incremented then the
+    horizontal bits copied from t. The pre-render line copies the
+    horizontal bits then, by its last dot of copying, the vertical ones.
+    A write landing on one of these dots comes after it.
+*/
+static const int walkDots[2][2] = {
+    {257, 304}, {256, 257}
+};
+
+/* ---------------
+    Set up and CHR
+    -------------- */
+static void handleEvent(void *context, enum Event event);
+static int initRenderer(struct PPU *ppu, enum Mirroring mirroring);
+static void freeRenderer(struct PPU *ppu);
+static void change(struct PPU *ppu, uint8_t kind, uint16_t address, uint8_t data);
+static void apply(struct PPU *ppu, uint8_t kind, uint16_t address, uint8_t data);
+
+/*
+    The scanline PPU comes in two halves. This one follows the CPU, taking
+    every write as it happens and stepping v a line at a time so it can
+    work out vblank, sprite 0 and overflow, but it never draws. Each change
+    is also logged, and the renderer, a second PPU sharing the CHR, replays
+    the log to draw the frame.
+*/
+int ppu_init(struct PPU *ppu, struct Scheduler *scheduler, uint8_t *chr, uint32_t chrSize, enum Mirroring mirroring) {
+    memset(ppu, 0, sizeof(struct PPU));
+    ppu->scheduler = scheduler;
+    ppu->frameStart = scheduler->now;
+    ppu->chrIsRam = (chrSize == 0);
+    if (ppu->chrIsRam) {
+        chrSize = 0x2000;
+        chr = calloc(chrSize, 1);
+        if (chr == NULL) {
+            return 0;
+        }
+    }
+    ppu->chr = chr;
+    ppu->chrSize = chrSize;
+    if (!tilecache_init(&ppu->tiles, chr, chrSize)) {
+        return 0;
+    }
+    ppu_mapChr(ppu, 0, 8, 0);
+    ppu_setMirroring(ppu, mirroring);
+    ppu->spriteLists.dirty = 1;
+
+    if (!initRenderer(ppu, mirroring)) {
+        return 0;
+    }
+
+    scheduler_setHandler(scheduler, EVENT_VBLANK, &handleEvent, ppu);
+    scheduler_setHandler(scheduler, EVENT_PRERENDER, &handleEvent, ppu);
+    scheduler_setHandler(scheduler, EVENT_SPRITE0_HIT, &handleEvent, ppu);
+    scheduler_setHandler(scheduler, EVENT_SPRITE_OVERFLOW, &handleEvent, ppu);
+    scheduler_schedule(scheduler, EVENT_VBLANK, ppu->frameStart + PPU_VBLANK_LINE * PPU_DOTS_PER_LINE + 1);
+    return 1;
+}
+
+/*
+    The renderer goes first, its thread may still be reading the CHR and
+    tiles shared with it
+*/
+void ppu_free(struct PPU *ppu) {
+    freeRenderer(ppu);
+    tilecache_free(&ppu->tiles);
+    if (ppu->chrIsRam) {
+        free(ppu->chr);
+    }
+    ppu->chr = NULL;
+}
+
+void ppu_setMirroring(struct PPU *ppu, enum Mirroring mirroring) {
+    change(ppu, LOG_MIRRORING, 0, mirroring);
+}
+
+/*
+    Points count 1KB slots starting at slot at the bank'th count KB of CHR.
+    The decoded tiles are swapped with the raw ones, so a bank switch never
+    decodes anything
+*/
+void ppu_mapChr(struct PPU *ppu, int slot, int count, uint32_t bank) {
+    change(ppu, LOG_CHR_BANK, bank, slot | (count << 4));
+}
+
+
+/*
+    Renders one frame then skips the next frameSkip. Skipped frames still
+    walk v, and sprite 0, overflow and vblank never depend on drawing, so
+    only the pixels are missing.
+*/
+void ppu_setFrameSkip(struct PPU *ppu, int frameSkip) {
+    ppu->frameSkip = frameSkip;
+    ppu->skipCount = 0;
+}
+
+
+/*
+    Chooses the renderer, before the PPU has run. The dot renderer raises
+    sprite 0 and overflow itself and draws as the CPU goes, so it needs
+    neither predictions nor the log.
+*/
+void ppu_setCore(struct PPU *ppu, enum PPUCore core) {
+    ppu->core = core;
+    scheduler_cancel(ppu->scheduler, EVENT_SPRITE0_HIT);
+    scheduler_cancel(ppu->scheduler, EVENT_SPRITE_OVERFLOW);
+    if (core == PPU_CORE_DOT) {
+        freeRenderer(ppu);
+        ppudot_start(ppu);
+    }
+}
+
+
+/*
+    The renderer starts as a copy of the PPU with its own nametables and
+    background layer. CHR ROM and its decoded tiles are shared, but CHR RAM
+    is written while the renderer may still be drawing the frame before, so
+    it gets its own copy kept up to date from the log.
+*/
+static int initRenderer(struct PPU *ppu, enum Mirroring mirroring) {
+    struct PPU *renderer = malloc(sizeof(struct PPU));
+    ppu->log = malloc(sizeof(struct PPULog));
+    if (renderer == NULL || ppu->log == NULL) {
+        free(renderer);
+        free(ppu->log);
+        ppu->log = NULL;
+        return 0;
+    }
+    memcpy(renderer, ppu, sizeof(struct PPU));
+    renderer->log = NULL;
+    renderer->layer = bglayer_create();
+    if (renderer->layer == NULL) {
+        free(renderer);
+        free(ppu->log);
+        ppu->log = NULL;
+        return 0;
+    }
+    if (ppu->chrIsRam) {
+        renderer->chr = calloc(ppu->chrSize, 1);
+        if (renderer->chr == NULL || !tilecache_init(&renderer->tiles, renderer->chr, ppu->chrSize)) {
+            free(renderer->chr);
+            free(renderer->layer);
+            free(renderer);
+            free(ppu->log);
+            ppu->log = NULL;
+            return 0;
+        }
+        apply(renderer, LOG_CHR_BANK, 0, 8 << 4);
+    }
+    apply(renderer, LOG_MIRRORING, 0, mirroring);
+    ppulog_init(ppu->log);
+    ppu->renderer = renderer;
+    return 1;
+}
+
+static void freeRenderer(struct PPU *ppu) {
+    if (ppu->thread != NULL) {
+        pputhread_stop(ppu->thread);
+        free(ppu->thread);
+        ppu->thread = NULL;
+    }
+    else {
+        free(ppu->log);
+    }
+    ppu->log = NULL;
+    if (ppu->renderer != NULL && ppu->chrIsRam) {
+        tilecache_free(&ppu->renderer->tiles);
+        free(ppu->renderer->chr);
+    }
+    if (ppu->renderer != NULL) {
+        free(ppu->renderer->layer);
+    }
+    free(ppu->renderer);
+    ppu->renderer = NULL;
+}
+
+/*
+    Moves the renderer onto its own thread, drawing one frame behind the
+    CPU. Only the scanline PPU has a renderer to move.
+*/
+int ppu_startThread(struct PPU *ppu) {
+    if (ppu->renderer == NULL) {
+        return 0;
+    }
+    struct PPUThread *thread = malloc(sizeof(struct PPUThread));
+    if (thread == NULL) {
+        return 0;
+    }
+    ppu_renderChunk(ppu->renderer, ppu->log, ppu->scheduler->now);
+    if (!pputhread_start(thread, ppu->renderer)) {
+        free(thread);
+        return 0;
+    }
+    free(ppu->log);
+    ppu->log = pputhread_log(thread);
+    ppu->thread = thread;
+    return 1;
+}
+
+/*
+    Gets the last finished frame, returning 0 if it was skipped. From the
+    render thread that is the frame before the one just finished.
+*/
+int ppu_output(struct PPU *ppu, const uint8_t **pixels, const uint8_t **emphasis) {
+    if (ppu->thread != NULL) {
+        return pputhread_frame(ppu->thread, pixels, emphasis);
+    }
+    const struct PPU *output = (ppu->renderer != NULL) ? ppu->renderer : ppu;
+    *pixels = output->frameBuffer;
+    *emphasis = output->emphasis;
+    return !ppu->skipping;
+}
+
+
+/* ------------
+    PPU Memory
+    ----------- */
+static uint8_t *paletteEntry(struct PPU *ppu, uint16_t address) {
+    address &= 0x1F;
+    if ((address & 0x13) == 0x10) {
+        address &= 0x0F;
+    }
+    return &ppu->palette[address];
+}
+
+static uint8_t ppu_read(struct PPU *ppu, uint16_t address) {
+    address &= 0x3FFF;
+    if (address < 0x2000) {
+        return ppu->chrBanks[address >> 10][address & 0x3FF];
+    }
+    if (address < 0x3F00) {
+        return ppu->nametableMap[(address >> 10) & 3][address & 0x3FF];
+    }
+    return *paletteEntry(ppu, address);
+}
+
+static void ppu_write(struct PPU *ppu, uint16_t address, uint8_t data) {
+    address &= 0x3FFF;
+    if (address < 0x2000) {
+        if (ppu->chrIsRam) {
+            uint8_t *byte = &ppu->chrBanks[address >> 10][address & 0x3FF];
+            *byte = data;
+            tilecache_markDirty(&ppu->tiles, (uint32_t)(byte - ppu->chr));
+            if (ppu->layer != NULL) {
+                bglayer_markPattern(ppu->layer, address);
+            }
+        }
+    }
+    else if (address < 0x3F00) {
+        ppu->nametableMap[(address >> 10) & 3][address & 0x3FF] = data;
+        if (ppu->layer != NULL) {
+            bglayer_markWrite(ppu->layer, ppu, address);
+        }
+    }
+    else {
+        *paletteEntry(ppu, address) = data & 0x3F;
+    }
+}
+
+
+/* ------------
+    PPU State
+    ----------- */
+
+/*
+    Makes one change to PPU state. Both halves go through here, the CPU
+    side as the write happens and the renderer as it replays the log.
+*/
+static void apply(struct PPU *ppu, uint8_t kind, uint16_t address, uint8_t data) {
+    static const uint8_t layouts[5][4] = {
+        {0, 0, 1, 1}, {0, 1, 0, 1}, {0, 0, 0, 0}, {1, 1, 1, 1}, {0, 1, 2, 3}
+    };
+    switch (kind) {
+        case LOG_CONTROL:
+            if (ppu->layer != NULL && ((ppu->control ^ data) & 0x10)) {
+                bglayer_markAll(ppu->layer);
+            }
+            ppu->control = data;
+            ppu->tempAddress = (ppu->tempAddress & 0xF3FF) | ((uint16_t)(data & 0x03) << 10);
+            break;
+        case LOG_MASK:
+            ppu->mask = data;
+            break;
+        case LOG_SCROLL_FIRST:
+            ppu->tempAddress = (ppu->tempAddress & 0xFFE0) | (data >> 3);
+            ppu->fineX = data & 0x07;
+            break;
+        case LOG_SCROLL_SECOND:
+            ppu->tempAddress = (ppu->tempAddress & 0x8C1F) | ((uint16_t)(data & 0x07) << 12) | ((uint16_t)(data & 0xF8) << 2);
+            break;
+        case LOG_ADDRESS_FIRST:
+            ppu->tempAddress = (ppu->tempAddress & 0x00FF) | ((uint16_t)(data & 0x3F) << 8);
+            break;
+        case LOG_ADDRESS_SECOND:
+            ppu->tempAddress = (ppu->tempAddress & 0xFF00) | data;
+            ppu->vramAddress = ppu->tempAddress;
+            break;
+        case LOG_DATA_WRITE:
+            ppu_write(ppu, ppu->vramAddress, data);
+            ppu->vramAddress += (ppu->control & 0x04) ? 32 : 1;
+            break;
+        case LOG_DATA_READ:
+            ppu->vramAddress += (ppu->control & 0x04) ? 32 : 1;
+            break;
+        case LOG_OAM_DATA:
+            ppu->oam[address & 0xFF] = data;
+            ppu->spriteLists.dirty = 1;
+            break;
+        case LOG_CHR_BANK: {
+            int slot = data & 0x0F;
+            int count = data >> 4;
+            uint32_t banks = ppu->chrSize / 0x400;
+            for (int i = 0; i < count; i++) {
+                uint32_t chrBank = ((uint32_t)address * count + i) % banks;
+                ppu->chrBanks[slot + i] = ppu->chr + chrBank * 0x400;
+                ppu->tileBanks[slot + i] = ppu->tiles.rows + chrBank * 64 * TILE_ROWS;
+            }
+            int background = (ppu->control & 0x10) >> 2;
+            if (ppu->layer != NULL && slot < background + 4 && slot + count > background) {
+                bglayer_markAll(ppu->layer);
+            }
+            break;
+        }
+        case LOG_MIRRORING:
+            for (int table = 0; table < 4; table++) {
+                ppu->nametableMap[table] = ppu->nametables + layouts[data][table] * 0x400;
+            }
+            if (ppu->layer != NULL) {
+                bglayer_markAll(ppu->layer);
+            }
+            break;
+    }
+}
+
+/*
+    $4014, copies a whole page into OAM starting at OAMADDR
+*/
+static void applyDma(struct PPU *ppu, const uint8_t *page) {
+    uint8_t start = ppu->oamAddress;
+    memcpy(&ppu->oam[start], page, 256 - start);
+    memcpy(ppu->oam, page + 256 - start, start);
+    ppu->spriteLists.dirty = 1;
+}
+
+static void beforeChange(struct PPU *ppu);
+static void afterChange(struct PPU *ppu);
+static void drainLog(struct PPU *ppu, int frameEnd);
+
+/*
+    Only the CPU side logs. A full log is made room in by rendering.
+*/
+static void logChange(struct PPU *ppu, uint8_t kind, uint16_t address, uint8_t data) {
+    if (ppu->renderer == NULL) {
+        return;
+    }
+    if (!ppulog_append(ppu->log, ppu->scheduler->now, kind, address, data)) {
+        drainLog(ppu, 0);
+        ppulog_append(ppu->log, ppu->scheduler->now, kind, address, data);
+    }
+}
+
+static void change(struct PPU *ppu, uint8_t kind, uint16_t address, uint8_t data) {
+    beforeChange(ppu);
+    apply(ppu, kind, address, data);
+    logChange(ppu, kind, address, data);
+    afterChange(ppu);
+}
+
+
+/* ---------------
+    CPU Registers
+    -------------- */
+/*
+    $2002 only runs the scheduler, any vblank or sprite 0 hit that is due
+    has already been worked out so nothing needs rendering to answer it.
+    The dot renderer finds hits by drawing, so it has to catch up.
+*/
+uint8_t ppu_readRegister(struct PPU *ppu, uint16_t address) {
+    uint8_t data = 0;
+    switch (address & 7) {
+        case 2:
+            scheduler_run(ppu->scheduler);
+            if (ppu->core == PPU_CORE_DOT) {
+                ppudot_catchUp(ppu);
+            }
+            data = (ppu->status & 0xE0) | (ppu->readBuffer & 0x1F);
+            ppu->status &= 0x7F;
+            ppu->writeToggle = 0;
+            break;
+        case 4:
+            data = ppu->oam[ppu->oamAddress];
+            break;
+        case 7:
+            beforeChange(ppu);
+            if ((ppu->vramAddress & 0x3FFF) < 0x3F00) {
+                data = ppu->readBuffer;
+                ppu->readBuffer = ppu_read(ppu, ppu->vramAddress);
+            }
+            else {
+                data = ppu_read(ppu, ppu->vramAddress);
+                ppu->readBuffer = ppu_read(ppu, ppu->vramAddress - 0x1000);
+            }
+            apply(ppu, LOG_DATA_READ, 0, 0);
+            logChange(ppu, LOG_DATA_READ, 0, 0);
+            afterChange(ppu);
+            break;
+    }
+    return data;
+}
+
+/*
+    Writes are resolved against everything only the CPU side keeps, the
+    NMI edge, the write toggle and OAMADDR, before being applied and logged
+*/
+void ppu_writeRegister(struct PPU *ppu, uint16_t address, uint8_t data) {
+    uint8_t kind;
+    uint16_t oamAddress = 0;
+    switch (address & 7) {
+        case 0:
+            if ((data & 0x80) && !(ppu->control & 0x80) && (ppu->status & 0x80)) {
+                ppu->nmiPending = 1;
+            }
+            kind = LOG_CONTROL;
+            break;
+        case 1:
+            kind = LOG_MASK;
+            break;
+        case 3:
+            ppu->oamAddress = data;
+            return;
+        case 4:
+            kind = LOG_OAM_DATA;
+            oamAddress = ppu->oamAddress++;
+            break;
+        case 5:
+            kind = ppu->writeToggle ? LOG_SCROLL_SECOND : LOG_SCROLL_FIRST;
+            ppu->writeToggle ^= 1;
+            break;
+        case 6:
+            kind = ppu->writeToggle ? LOG_ADDRESS_SECOND : LOG_ADDRESS_FIRST;
+            ppu->writeToggle ^= 1;
+            break;
+        case 7:
+            kind = LOG_DATA_WRITE;
+            break;
+        default:
+            return;
+    }
+    change(ppu, kind, oamAddress, data);
+}
+
+void ppu_oamDma(struct PPU *ppu, const uint8_t *page) {
+    beforeChange(ppu);
+    applyDma(ppu, page);
+    if (ppu->renderer != NULL && !ppulog_appendPage(ppu->log, ppu->scheduler->now, page)) {
+        drainLog(ppu, 0);
+        ppulog_appendPage(ppu->log, ppu->scheduler->now, page);
+    }
+    afterChange(ppu);
+}
+
+
+/* -----------------
+    Scanline Render
+    ---------------- */
+/*
+    v as it will be at the start of the following line
+*/
+static uint16_t nextLine(uint16_t v, uint16_t t) {
+    return (ppu_incrementY(v) & ~0x041F) | (t & 0x041F);
+}
+
+static int walkDot(int line, int step) {
+    return walkDots[line >= 0][step];
+}
+
+/*
+    Makes the step'th change to v on line
+*/
+static void walkStep(struct PPU *ppu, int line, int step) {
+    if (!ppu_renderingEnabled(ppu)) {
+        return;
+    }
+    uint16_t v = ppu->vramAddress;
+    uint16_t t = ppu->tempAddress;
+    if (line >= 0 && step == 0) {
+        ppu->vramAddress = ppu_incrementY(v);
+    }
+    else if (line >= 0 || step == 0) {
+        ppu->vramAddress = (v & ~0x041F) | (t & 0x041F);
+    }
+    else {
+        ppu->vramAddress = (v & 0x041F) | (t & ~0x041F);
+    }
+}
+
+/*
+    Fetches the 33 tiles under the line, copied from the background layer
+    when it has them. Otherwise each one is a single load from the tile
+    cache with its attribute ORed into all 8 pixels at once.
+*/
+static void renderBackground(struct PPU *ppu) {
+    uint16_t v = ppu->vramAddress;
+    if (ppu->tiles.dirtyCount) {
+        tilecache_flush(&ppu->tiles);
+    }
+    if (ppu->layer != NULL && bglayer_fetchLine(ppu->layer, ppu, v, ppu->backgroundLine)) {
+        return;
+    }
+
+    for (int tile = 0; tile < 33; tile++) {
+        uint64_t row = ppu_backgroundPattern(ppu, v) | (ppu_paletteAt(ppu, v) * 0x0404040404040404ULL);
+        memcpy(&ppu->backgroundLine[tile * 8], &row, sizeof(row));
+        v = ppu_incrementX(v);
+    }
+}
+
+/*
+    Sprite pixels are 0x10 | palette << 2 | pattern, bit 6 marks sprite 0 and
+    bit 7 puts the sprite behind the background. The line's sprites come
+    from the prebuilt lists and are drawn back to front so earlier ones win.
+*/
+static void renderSprites(struct PPU *ppu, int line) {
+    memset(ppu->spriteLine, 0, sizeof(ppu->spriteLine));
+    int height = (ppu->control & 0x20) ? 16 : 8;
+    struct SpriteLists *lists = &ppu->spriteLists;
+    if (lists->dirty || lists->height != height) {
+        sprites_build(lists, ppu->oam, height);
+    }
+
+    for (int i = lists->count[line] - 1; i >= 0; i--) {
+        int sprite = lists->sprites[line][i];
+        const uint8_t *entry = &ppu->oam[sprite * 4];
+        uint64_t pixels = ppu_spritePattern(ppu, entry, line - 1 - entry[0], height);
+        uint8_t attributes = entry[2];
+        uint8_t extra = 0x10 | ((attributes & 0x03) << 2) | ((attributes & 0x20) << 2) | ((sprite == 0) ? 0x40 : 0);
+
+        for (int pixel = 0; pixel < 8 && entry[3] + pixel < PPU_WIDTH; pixel++) {
+            uint8_t value = (pixels >> (pixel * 8)) & 0x03;
+            if (value) {
+                ppu->spriteLine[entry[3] + pixel] = value | extra;
+            }
+        }
+    }
+}
+
+/*
+    Composes pixels first to last - 1 of the line with the mask, palette
+    and fine X as they are now. A whole line goes straight into the frame.
+*/
+static void composeSpan(struct PPU *ppu, int line, int first, int last) {
+    uint8_t indices[PPU_WIDTH];
+    uint8_t colours[PPU_WIDTH];
+    uint8_t *out = &ppu->frameBuffer[line * PPU_WIDTH];
+    uint8_t greyscale = (ppu->mask & 0x01) ? 0x30 : 0x3F;
+    compose->merge(indices, ppu->backgroundLine + ppu->fineX, ppu->spriteLine, ppu->mask);
+    if (first == 0 && last == PPU_WIDTH) {
+        compose->palette(out, indices, ppu->palette, greyscale);
+        return;
+    }
+    compose->palette(colours, indices, ppu->palette, greyscale);
+    memcpy(out + first, colours + first, last - first);
+}
+
+/*
+    Applies every logged change made up to and including time, stopping
+    early once a new frame has begun so its lines get drawn first
+*/
+static void replay(struct PPU *ppu, struct PPULog *log, uint64_t time) {
+    const struct LogEntry *entry;
+    while ((entry = ppulog_peek(log)) != NULL && entry->time <= time) {
+        if (entry->kind == LOG_FRAME) {
+            ppu->frameStart = entry->time + entry->address;
+            ppu->line = -1;
+            ppu->skipping = entry->data;
+            ppulog_pop(log);
+            return;
+        }
+        if (entry->kind == LOG_OAM_DMA) {
+            applyDma(ppu, ppulog_page(log));
+        }
+        else {
+            apply(ppu, entry->kind, entry->address, entry->data);
+        }
+        ppulog_pop(log);
+    }
+}
+
+/*
+    Draws one line's pixels on the renderer. Pixel x goes out on dot x + 1,
+    so a change logged on dot d of the line shows from pixel d on and the
+    line is composed in spans between changes. Tiles and sprites are
+    fetched once, for the first span drawn with rendering on.
+*/
+static void drawLine(struct PPU *ppu, struct PPULog *log, int line, uint64_t lineStart) {
+    replay(ppu, log, lineStart);
+    if (ppu->skipping) {
+        return;
+    }
+
+    int fetched = 0;
+    int x = 0;
+    while (x < PPU_WIDTH) {
+        const struct LogEntry *entry = ppulog_peek(log);
+        int end = PPU_WIDTH;
+        if (entry != NULL && entry->time < lineStart + PPU_WIDTH) {
+            end = (int)(entry->time - lineStart);
+        }
+        if (end > x) {
+            if (!ppu_renderingEnabled(ppu)) {
+                memset(&ppu->frameBuffer[line * PPU_WIDTH + x], ppu->palette[0], end - x);
+            }
+            else {
+                if (!fetched) {
+                    renderBackground(ppu);
+                    renderSprites(ppu, line);
+                    fetched = 1;
+                }
+                composeSpan(ppu, line, x, end);
+            }
+            x = end;
+        }
+        if (end < PPU_WIDTH) {
+            replay(ppu, log, entry->time);
+        }
+    }
+    ppu->emphasis[line] = ppu->mask >> 5;
+}
+
+/*
+    Brings the renderer up to now, drawing every line that has finished.
+    Once a frame is done the log is replayed until the next one begins,
+    frameReady being set for whoever is waiting on the pixels.
+*/
+static void render(struct PPU *ppu, struct PPULog *log, uint64_t now) {
+    if (ppu->tiles.dirtyCount) {
+        tilecache_flush(&ppu->tiles);
+    }
+    for (;;) {
+        while (ppu->line < PPU_HEIGHT) {
+            uint64_t lineStart = ppu->frameStart + (int64_t)ppu->line * PPU_DOTS_PER_LINE;
+            if (now < lineStart + walkDot(ppu->line, 1)) {
+                return;
+            }
+            if (ppu->line >= 0) {
+                drawLine(ppu, log, ppu->line, lineStart);
+            }
+            for (int step = 0; step < 2; step++) {
+                replay(ppu, log, lineStart + walkDot(ppu->line, step) - 1);
+                walkStep(ppu, ppu->line, step);
+            }
+            ppu->line++;
+            ppu->frameReady |= (ppu->line == PPU_HEIGHT);
+        }
+        replay(ppu, log, now);
+        if (ppu->line == PPU_HEIGHT) {
+            return;
+        }
+    }
+}
+
+/*
+    Draws a log handed over by the CPU side up to end. Anything left over
+    falls in the line end is on and is replayed as it stands, as the log
+    is about to be reused.
+*/
+void ppu_renderChunk(struct PPU *renderer, struct PPULog *log, uint64_t end) {
+    render(renderer, log, end);
+    replay(renderer, log, end);
+}
+
+/*
+    Empties the log. With a render thread it is handed over, otherwise the
+    renderer draws as far as the CPU has got, and a log filled within a
+    single line is replayed as it stands, the line showing only the final
+    state.
+*/
+static void drainLog(struct PPU *ppu, int frameEnd) {
+    if (ppu->thread != NULL) {
+        ppu->log = pputhread_submit(ppu->thread, ppu->scheduler->now, frameEnd);
+        return;
+    }
+    render(ppu->renderer, ppu->log, ppu->scheduler->now);
+    if (ppulog_full(ppu->log)) {
+        replay(ppu->renderer, ppu->log, ppu->scheduler->now);
+    }
+}
+
+
+/* --------------------
+    Sprite 0 Prediction
+    ------------------- */
+static uint8_t opaqueBits(uint64_t pixels) {
+    uint8_t bits = 0;
+    for (int pixel = 0; pixel < 8; pixel++) {
+        if ((pixels >> (pixel * 8)) & 0x03) {
+            bits |= 1 << pixel;
+        }
+    }
+    return bits;
+}
+
+/*
+    Works out the exact dot sprite 0 will hit on from sprite 0's opaque
+    pixels and the background tiles under them, stepping v forward a line
+    at a time from the next line to be drawn. Anything that could change
+    the answer calls this again via afterChange.
+
+    Called mid-line, the pixels already out are skipped, and once the line
+    is done with its Y increment made the prediction starts on the next
+    line, with the horizontal reload due on dot 257 made first. On the
+    pre-render line v is what t will have copied into it by dot 304.
+*/
+static void predictSprite0(struct PPU *ppu) {
+    scheduler_cancel(ppu->scheduler, EVENT_SPRITE0_HIT);
+    if ((ppu->status & 0x40) || (ppu->mask & 0x18) != 0x18) {
+        return;
+    }
+    if (ppu->tiles.dirtyCount) {
+        tilecache_flush(&ppu->tiles);
+    }
+    const uint8_t *sprite = ppu->oam;
+    int height = (ppu->control & 0x20) ? 16 : 8;
+    int top = sprite[0] + 1;
+    int first = ppu->line;
+    uint16_t v = ppu->vramAddress;
+    uint16_t t = ppu->tempAddress;
+    int drawn = 0;
+    if (ppu->line < 0) {
+        first = 0;
+        v = ppu->walked ? ((v & 0x041F) | (t & ~0x041F)) : t;
+    }
+    else if (ppu->walked) {
+        first++;
+        v = (v & ~0x041F) | (t & 0x041F);
+    }
+    else {
+        int64_t dot = (int64_t)(ppu->scheduler->now - ppu->frameStart) - (int64_t)first * PPU_DOTS_PER_LINE;
+        drawn = (dot < 0) ? 0 : (int)dot;
+    }
+
+    uint8_t clip = 0xFF;
+    if (sprite[3] < 8 && (ppu->mask & 0x06) != 0x06) {
+        clip <<= 8 - sprite[3];
+    }
+    if (sprite[3] >= 0xF8) {
+        clip &= 0x7F >> (sprite[3] - 0xF8);
+    }
+
+    for (int line = first; line < PPU_HEIGHT && line < top + height; line++) {
+        if (line >= top) {
+            uint8_t spriteBits = opaqueBits(ppu_spritePattern(ppu, sprite, line - top, height));
+            int offset = sprite[3] + ppu->fineX;
+            uint16_t tileAddress = v;
+            for (int tile = 0; tile < (offset >> 3); tile++) {
+                tileAddress = ppu_incrementX(tileAddress);
+            }
+            uint16_t following = ppu_incrementX(tileAddress);
+            uint16_t backgroundBits = opaqueBits(ppu_backgroundPattern(ppu, tileAddress)) | ((uint16_t)opaqueBits(ppu_backgroundPattern(ppu, following)) << 8);
+            uint8_t hits = spriteBits & clip & (uint8_t)(backgroundBits >> (offset & 7));
+            if (line == first && drawn > sprite[3]) {
+                hits = (drawn - sprite[3] >= 8) ? 0 : hits & (0xFF << (drawn - sprite[3]));
+            }
+            if (hits) {
+                int x = sprite[3] + __builtin_ctz(hits);
+                scheduler_schedule(ppu->scheduler, EVENT_SPRITE0_HIT, ppu->frameStart + (uint64_t)line * PPU_DOTS_PER_LINE + x + 1);
+                return;
+            }
+        }
+        v = nextLine(v, t);
+    }
+}
+
+
+/*
+    Overflow comes straight from the sprite lists. It is set once the
+    evaluation for the first overflowing line ends, on the line before it.
+    Nothing is drawn on line 0, so that line never overflows.
+*/
+static void predictOverflow(struct PPU *ppu) {
+    scheduler_cancel(ppu->scheduler, EVENT_SPRITE_OVERFLOW);
+    if ((ppu->status & 0x20) || !ppu_renderingEnabled(ppu)) {
+        return;
+    }
+    int height = (ppu->control & 0x20) ? 16 : 8;
+    struct SpriteLists *lists = &ppu->spriteLists;
+    if (lists->dirty || lists->height != height) {
+        sprites_build(lists, ppu->oam, height);
+    }
+    for (int line = (ppu->line < 1) ? 1 : ppu->line; line < PPU_HEIGHT; line++) {
+        if (lists->overflow[line]) {
+            scheduler_schedule(ppu->scheduler, EVENT_SPRITE_OVERFLOW, ppu->frameStart + (uint64_t)(line - 1) * PPU_DOTS_PER_LINE + PPU_WIDTH + 1);
+            return;
+        }
+    }
+}
+
+
+/* -------
+    Timing
+    ------ */
+
+/*
+    Walks v up to now, which is all the CPU side needs to predict from, the
+    drawing is left to the renderer. ppu->line is the next line to finish,
+    -1 being the pre-render line, and ppu->walked how many of its changes
+    to v have been made. The dot renderer runs every dot up to now instead.
+*/
+void ppu_catchUp(struct PPU *ppu) {
+    if (ppu->core == PPU_CORE_DOT) {
+        ppudot_catchUp(ppu);
+        return;
+    }
+    uint64_t now = ppu->scheduler->now;
+    while (ppu->line < PPU_HEIGHT) {
+        uint64_t lineStart = ppu->frameStart + (int64_t)ppu->line * PPU_DOTS_PER_LINE;
+        if (now < lineStart + walkDot(ppu->line, ppu->walked)) {
+            return;
+        }
+        walkStep(ppu, ppu->line, ppu->walked);
+        ppu->walked ^= 1;
+        if (!ppu->walked) {
+            ppu->line++;
+        }
+    }
+}
+
+static void beforeChange(struct PPU *ppu) {
+    ppu_catchUp(ppu);
+}
+
+/*
+    Sprite 0 and overflow for the next frame are predicted at pre-render,
+    so changes made during vblank don't need to predict again
+*/
+static void afterChange(struct PPU *ppu) {
+    if (ppu->core == PPU_CORE_SCANLINE && ppu->line < PPU_HEIGHT) {
+        predictSprite0(ppu);
+        predictOverflow(ppu);
+    }
+}
+
+/*
+    The renderer is handed the frame at vblank, and told where the next one
+    starts by a log entry at pre-render
+*/
+static void handleEvent(void *context, enum Event event) {
+    struct PPU *ppu = context;
+    switch (event) {
+        case EVENT_VBLANK:
+            ppu_catchUp(ppu);
+            if (ppu->renderer != NULL) {
+                drainLog(ppu, 1);
+            }
+            ppu->status |= 0x80;
+            ppu->frameReady = 1;
+            if (ppu->control & 0x80) {
+                ppu->nmiPending = 1;
+            }
+            scheduler_schedule(ppu->scheduler, EVENT_PRERENDER, ppu->frameStart + PPU_PRERENDER_LINE * PPU_DOTS_PER_LINE + 1);
+            break;
+        case EVENT_PRERENDER:
+            ppu->status &= 0x1F;
+            ppu->oddFrame ^= 1;
+            ppu->frameStart += PPU_LINES_PER_FRAME * PPU_DOTS_PER_LINE;
+            if (ppu->oddFrame && ppu_renderingEnabled(ppu)) {
+                ppu->frameStart--;
+            }
+            ppu->line = -1;
+            ppu->walked = 0;
+            ppu->skipping = (ppu->skipCount > 0);
+            ppu->skipCount = ppu->skipping ? ppu->skipCount - 1 : ppu->frameSkip;
+            logChange(ppu, LOG_FRAME, ppu->frameStart - ppu->scheduler->now, ppu->skipping);
+            scheduler_schedule(ppu->scheduler, EVENT_VBLANK, ppu->frameStart + PPU_VBLANK_LINE * PPU_DOTS_PER_LINE + 1);
+            if (ppu->core == PPU_CORE_SCANLINE) {
+                predictSprite0(ppu);
+                predictOverflow(ppu);
+            }
+            break;
+        case EVENT_SPRITE0_HIT:
+            ppu->status |= 0x40;
+            break;
+        case EVENT_SPRITE_OVERFLOW:
+            ppu->status |= 0x20;
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,383 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "./headers/ppu.h"
+#include "./headers/ppudot.h"
+#include "./headers/ppufetch.h"
+#include "./headers/tilecache.h"
+
+
+/*
+    The dot accurate renderer. It keeps the scanline renderer's register
+    file, memory, tile cache and frame buffer, but runs the fetch pipeline
+    one dot at a time so writes land on the pixel they happen on. Sprite 0
+    hits and overflow are raised as they happen rather than predicted.
+
+    Each 8 dot fetch group latches the name byte on its first dot, the
+    attribute on its third and the whole pattern row from the tile cache on
+    its fifth, then loads the shifter and steps v on its eighth.
+
+    Catching up only ever runs to the dot the CPU is on before it touches
+    the PPU, so nothing can change partway through a group lying wholly in
+    the past. Such groups are run in one go, eight pixels at a time in 64
+    bit words, and only the dots either side of a write are stepped singly.
+*/
+
+
+/* ---------------
+    Set up
+    -------------- */
+
+/*
+    Places the renderer on the dot the scheduler is at, so it can take over
+    from a fresh PPU
+*/
+void ppudot_start(struct PPU *ppu) {
+    struct DotState *dot = &ppu->dot;
+    memset(dot, 0, sizeof(struct DotState));
+    dot->time = ppu->scheduler->now;
+    if (dot->time < ppu->frameStart) {
+        uint64_t early = ppu->frameStart - dot->time;
+        dot->line = PPU_PRERENDER_LINE;
+        dot->dot = (early < PPU_DOTS_PER_LINE) ? PPU_DOTS_PER_LINE - (int)early : 0;
+        return;
+    }
+    uint64_t offset = dot->time - ppu->frameStart;
+    dot->line = (int)(offset / PPU_DOTS_PER_LINE);
+    dot->dot = (int)(offset % PPU_DOTS_PER_LINE);
+    if (dot->line > PPU_PRERENDER_LINE) {
+        dot->line = PPU_PRERENDER_LINE;
+    }
+}
+
+
+/* ------------
+    Background
+    ----------- */
+static void fetchBackground(struct PPU *ppu, struct DotState *dot) {
+    uint16_t v = ppu->vramAddress;
+    switch (dot->dot & 7) {
+        case 1:
+            dot->nameLatch = ppu_nameAt(ppu, v);
+            break;
+        case 3:
+            dot->paletteLatch = ppu_paletteAt(ppu, v);
+            break;
+        case 5:
+            if (ppu->tiles.dirtyCount) {
+                tilecache_flush(&ppu->tiles);
+            }
+            dot->patternLatch = ppu_patternRow(ppu, dot->nameLatch, v);
+            break;
+        case 0:
+            dot->shiftHigh = dot->patternLatch | (dot->paletteLatch * 0x0404040404040404ULL);
+            ppu->vramAddress = ppu_incrementX(v);
+            break;
+    }
+}
+
+static void shiftBackground(struct DotState *dot) {
+    dot->shiftLow = (dot->shiftLow >> 8) | (dot->shiftHigh << 56);
+    dot->shiftHigh >>= 8;
+}
+
+
+/* ---------
+    Sprites
+    -------- */
+
+/*
+    Picks the first eight sprites on the following line from OAM as it is
+    now, setting overflow if there are more
+*/
+static void evaluateSprites(struct PPU *ppu, struct DotState *dot) {
+    int height = (ppu->control & 0x20) ? 16 : 8;
+    dot->secondaryCount = 0;
+    for (int sprite = 0; sprite < 64; sprite++) {
+        int row = dot->line - ppu->oam[sprite * 4];
+        if (row < 0 || row >= height) {
+            continue;
+        }
+        if (dot->secondaryCount == SPRITES_PER_LINE) {
+            ppu->status |= 0x20;
+            break;
+        }
+        dot->secondary[dot->secondaryCount++] = sprite;
+    }
+}
+
+/*
+    Fetches one chosen sprite into the following line's sprite pixels, in
+    the same form renderSprites uses. Sprites are fetched in OAM order, so a
+    pixel already taken belongs to a sprite in front.
+*/
+static void fetchSprite(struct PPU *ppu, struct DotState *dot, int slot) {
+    if (slot >= dot->secondaryCount) {
+        return;
+    }
+    int sprite = dot->secondary[slot];
+    const uint8_t *entry = &ppu->oam[sprite * 4];
+    int height = (ppu->control & 0x20) ? 16 : 8;
+    int row = dot->line - entry[0];
+    if (row < 0 || row >= height) {
+        return;
+    }
+    if (ppu->tiles.dirtyCount) {
+        tilecache_flush(&ppu->tiles);
+    }
+    uint64_t pixels = ppu_spritePattern(ppu, entry, row, height);
+    uint8_t attributes = entry[2];
+    uint8_t extra = 0x10 | ((attributes & 0x03) << 2) | ((attributes & 0x20) << 2) | ((sprite == 0) ? 0x40 : 0);
+
+    for (int pixel = 0; pixel < 8 && entry[3] + pixel < PPU_WIDTH; pixel++) {
+        uint8_t value = (pixels >> (pixel * 8)) & 0x03;
+        if (value && !ppu->spriteLine[entry[3] + pixel]) {
+            ppu->spriteLine[entry[3] + pixel] = value | extra;
+        }
+    }
+}
+
+
+/* ---------
+    Drawing
+    -------- */
+
+/*
+    The per pixel version of the compose merge and palette kernels, reading
+    PPUMASK and fine X as they are on this dot
+*/
+static void drawPixel(struct PPU *ppu, struct DotState *dot, int x) {
+    uint8_t *out = &ppu->frameBuffer[dot->line * PPU_WIDTH + x];
+    uint8_t mask = ppu->mask;
+    if (x == PPU_WIDTH - 1) {
+        ppu->emphasis[dot->line] = mask >> 5;
+    }
+    if (!ppu_renderingEnabled(ppu)) {
+        if (!ppu->skipping) {
+            *out = ppu->palette[0];
+        }
+        return;
+    }
+
+    uint8_t b = (dot->shiftLow >> (ppu->fineX * 8)) & 0xFF;
+    uint8_t s = ppu->spriteLine[x];
+    if (!(mask & 0x08) || (x < 8 && !(mask & 0x02))) {
+        b = 0;
+    }
+    if (!(mask & 0x10) || (x < 8 && !(mask & 0x04))) {
+        s = 0;
+    }
+    uint8_t index = (b & 0x03) ? (b & 0x0F) : 0;
+    if (s & 0x03) {
+        if ((s & 0x40) && index && x != PPU_WIDTH - 1) {
+            ppu->status |= 0x40;
+        }
+        if (!(s & 0x80) || !index) {
+            index = s & 0x1F;
+        }
+    }
+    if (!ppu->skipping) {
+        *out = ppu->palette[index] & ((mask & 0x01) ? 0x30 : 0x3F);
+    }
+}
+
+
+/* -------------
+    Whole groups
+    ------------ */
+#define BYTES(value) ((value) * 0x0101010101010101ULL)
+
+/*
+    0xFF in every byte of bits that is nonzero, for bytes under 0x80
+*/
+static uint64_t nonzeroBytes(uint64_t bits) {
+    return (((bits + BYTES(0x7F)) & BYTES(0x80)) >> 7) * 0xFF;
+}
+
+/*
+    drawPixel for the eight pixels from x, with the background taken from
+    fine X onwards across both shift registers as it would be shifted out
+*/
+static void drawGroup(struct PPU *ppu, struct DotState *dot, int x) {
+    uint8_t *out = &ppu->frameBuffer[dot->line * PPU_WIDTH + x];
+    uint8_t mask = ppu->mask;
+    if (x == PPU_WIDTH - 8) {
+        ppu->emphasis[dot->line] = mask >> 5;
+    }
+    if (!ppu_renderingEnabled(ppu)) {
+        if (!ppu->skipping) {
+            memset(out, ppu->palette[0], 8);
+        }
+        return;
+    }
+
+    int shift = ppu->fineX * 8;
+    uint64_t b = shift ? (dot->shiftLow >> shift) | (dot->shiftHigh << (64 - shift)) : dot->shiftLow;
+    uint64_t s;
+    memcpy(&s, &ppu->spriteLine[x], sizeof(s));
+    if (!(mask & 0x08) || (x == 0 && !(mask & 0x02))) {
+        b = 0;
+    }
+    if (!(mask & 0x10) || (x == 0 && !(mask & 0x04))) {
+        s = 0;
+    }
+    uint64_t background = nonzeroBytes(b & BYTES(0x03));
+    uint64_t sprite = nonzeroBytes(s & BYTES(0x03));
+    uint64_t hits = sprite & background & (((s & BYTES(0x40)) >> 6) * 0xFF);
+    if (x == PPU_WIDTH - 8) {
+        hits &= ~(0xFFULL << 56);
+    }
+    if (hits) {
+        ppu->status |= 0x40;
+    }
+    uint64_t behind = ((s & BYTES(0x80)) >> 7) * 0xFF;
+    uint64_t front = sprite & ~(behind & background);
+    uint64_t index = (b & BYTES(0x0F) & background & ~front) | (s & BYTES(0x1F) & front);
+
+    if (!ppu->skipping) {
+        uint8_t grey = (mask & 0x01) ? 0x30 : 0x3F;
+        for (int pixel = 0; pixel < 8; pixel++) {
+            out[pixel] = ppu->palette[(index >> (pixel * 8)) & 0xFF] & grey;
+        }
+    }
+}
+
+/*
+    Whether the dot starts a fetch group, a sprite fetch or eight dots of
+    drawing with rendering off, that can be run as a whole
+*/
+static int groupStarts(const struct PPU *ppu, const struct DotState *dot) {
+    int cycle = dot->dot;
+    if ((cycle & 7) != 1) {
+        return 0;
+    }
+    if (!ppu_renderingEnabled(ppu)) {
+        return dot->line < PPU_HEIGHT && cycle <= PPU_WIDTH;
+    }
+    return (dot->line < PPU_HEIGHT || dot->line == PPU_PRERENDER_LINE) && (cycle <= 313 || (cycle >= 321 && cycle <= 336));
+}
+
+/*
+    Eight dots of step. Eight shifts leave the high register in the low one
+    and the fetches all read v as it was, since v only moves on the last.
+    Between the background fetches each group ends in a sprite fetch, and
+    the pre-render line's vertical copies just repeat the same copy.
+*/
+static void runGroup(struct PPU *ppu, struct DotState *dot) {
+    int cycle = dot->dot;
+    if (dot->line < PPU_HEIGHT && cycle <= PPU_WIDTH) {
+        drawGroup(ppu, dot, cycle - 1);
+    }
+    if (!ppu_renderingEnabled(ppu)) {
+        /* Nothing to fetch */
+    }
+    else if (cycle > PPU_WIDTH && cycle < 321) {
+        if (cycle == 257) {
+            ppu->vramAddress = (ppu->vramAddress & ~0x041F) | (ppu->tempAddress & 0x041F);
+            memset(ppu->spriteLine, 0, sizeof(ppu->spriteLine));
+            dot->secondaryCount = 0;
+            if (dot->line < PPU_HEIGHT) {
+                evaluateSprites(ppu, dot);
+            }
+        }
+        if (dot->line == PPU_PRERENDER_LINE && cycle + 7 >= 280 && cycle <= 304) {
+            ppu->vramAddress = (ppu->vramAddress & ~0x7BE0) | (ppu->tempAddress & 0x7BE0);
+        }
+        fetchSprite(ppu, dot, (cycle - 257) / 8);
+    }
+    else {
+        uint16_t v = ppu->vramAddress;
+        if (ppu->tiles.dirtyCount) {
+            tilecache_flush(&ppu->tiles);
+        }
+        dot->nameLatch = ppu_nameAt(ppu, v);
+        dot->paletteLatch = ppu_paletteAt(ppu, v);
+        dot->patternLatch = ppu_patternRow(ppu, dot->nameLatch, v);
+        dot->shiftLow = dot->shiftHigh;
+        dot->shiftHigh = dot->patternLatch | (dot->paletteLatch * 0x0404040404040404ULL);
+        ppu->vramAddress = ppu_incrementX(v);
+        if (cycle + 7 == 256) {
+            ppu->vramAddress = ppu_incrementY(ppu->vramAddress);
+        }
+    }
+    dot->time += 8;
+    dot->dot += 8;
+}
+
+
+/* -------
+    Timing
+    ------ */
+static void step(struct PPU *ppu, struct DotState *dot) {
+    int line = dot->line;
+    int cycle = dot->dot;
+    int visible = line < PPU_HEIGHT;
+
+    if (visible && cycle >= 1 && cycle <= PPU_WIDTH) {
+        drawPixel(ppu, dot, cycle - 1);
+    }
+    if (ppu_renderingEnabled(ppu) && (visible || line == PPU_PRERENDER_LINE)) {
+        if ((cycle >= 1 && cycle <= 256) || (cycle >= 321 && cycle <= 336)) {
+            shiftBackground(dot);
+            fetchBackground(ppu, dot);
+        }
+        if (cycle == 256) {
+            ppu->vramAddress = ppu_incrementY(ppu->vramAddress);
+        }
+        else if (cycle == 257) {
+            ppu->vramAddress = (ppu->vramAddress & ~0x041F) | (ppu->tempAddress & 0x041F);
+            memset(ppu->spriteLine, 0, sizeof(ppu->spriteLine));
+            dot->secondaryCount = 0;
+            if (visible) {
+                evaluateSprites(ppu, dot);
+            }
+        }
+        else if (line == PPU_PRERENDER_LINE && cycle >= 280 && cycle <= 304) {
+            ppu->vramAddress = (ppu->vramAddress & ~0x7BE0) | (ppu->tempAddress & 0x7BE0);
+        }
+        if (cycle >= 264 && cycle <= 320 && (cycle & 7) == 0) {
+            fetchSprite(ppu, dot, (cycle - 264) / 8);
+        }
+    }
+
+    dot->time++;
+    dot->dot++;
+    if (line == PPU_PRERENDER_LINE && dot->time == ppu->frameStart) {
+        dot->line = 0;
+        dot->dot = 0;
+    }
+    else if (dot->dot == PPU_DOTS_PER_LINE) {
+        dot->dot = 0;
+        dot->line = (line == PPU_PRERENDER_LINE) ? 0 : line + 1;
+    }
+}
+
+/*
+    Runs every dot up to and including now. The pre-render line ends when
+    the new frame starts, which is a dot early on odd frames. Nothing
+    happens on the lines after the picture until the pre-render line, so
+    they are skipped over.
+*/
+void ppudot_catchUp(struct PPU *ppu) {
+    uint64_t now = ppu->scheduler->now;
+    struct DotState *dot = &ppu->dot;
+    while (dot->time <= now) {
+        if (dot->line >= PPU_HEIGHT && dot->line < PPU_PRERENDER_LINE) {
+            uint64_t rest = PPU_DOTS_PER_LINE - dot->dot;
+            if (dot->time + rest <= now + 1) {
+                dot->time += rest;
+                dot->dot = 0;
+                dot->line++;
+                continue;
+            }
+            dot->dot += (int)(now + 1 - dot->time);
+            dot->time = now + 1;
+        }
+        else if (dot->time + 7 <= now && groupStarts(ppu, dot)) {
+            runGroup(ppu, dot);
+        }
+        else {
+            step(ppu, dot);
+        }
+    }
+}
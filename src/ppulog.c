@@ -0,0 +1,41 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "./headers/ppulog.h"
+
+
+void ppulog_init(struct PPULog *log) {
+    log->head = 0;
+    log->tail = 0;
+    log->pageHead = 0;
+    log->pageTail = 0;
+}
+
+/*
+    Returns 0 without logging anything if the ring is full
+*/
+int ppulog_append(struct PPULog *log, uint64_t time, uint8_t kind, uint16_t address, uint8_t data) {
+    if (log->head - log->tail == PPULOG_CAPACITY) {
+        return 0;
+    }
+    struct LogEntry *entry = &log->entries[log->head % PPULOG_CAPACITY];
+    entry->time = time;
+    entry->address = address;
+    entry->kind = kind;
+    entry->data = data;
+    log->head++;
+    return 1;
+}
+
+/*
+    Logs an OAM DMA along with a copy of the page, returns 0 if there is no
+    room for either
+*/
+int ppulog_appendPage(struct PPULog *log, uint64_t time, const uint8_t *page) {
+    if (log->pageHead - log->pageTail == PPULOG_PAGES || !ppulog_append(log, time, LOG_OAM_DMA, 0, 0)) {
+        return 0;
+    }
+    memcpy(log->pages[log->pageHead % PPULOG_PAGES], page, 256);
+    log->pageHead++;
+    return 1;
+}
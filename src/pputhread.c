@@ -0,0 +1,138 @@
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+
+#include "./headers/pputhread.h"
+#include "./headers/ppu.h"
+#include "./headers/ppulog.h"
+
+#define SPINS 64
+
+/*
+    Waits for a counter the other thread writes to reach target, returning
+    0 if the thread is stopped first. Handoffs are usually close together
+    so it yields a few times before going to sleep until signalled.
+*/
+static int waitFor(struct PPUThread *thread, atomic_uint *counter, unsigned target) {
+    for (int spin = 0; spin < SPINS; spin++) {
+        if (atomic_load_explicit(counter, memory_order_acquire) >= target) {
+            return 1;
+        }
+        if (!atomic_load_explicit(&thread->running, memory_order_relaxed)) {
+            return 0;
+        }
+        sched_yield();
+    }
+    pthread_mutex_lock(&thread->lock);
+    int reached;
+    while (!(reached = atomic_load_explicit(counter, memory_order_acquire) >= target) && atomic_load_explicit(&thread->running, memory_order_relaxed)) {
+        pthread_cond_wait(&thread->wake, &thread->lock);
+    }
+    pthread_mutex_unlock(&thread->lock);
+    return reached;
+}
+
+/*
+    Wakes the other thread after a store. Taking the lock means a waiter
+    is either still to check the counter or already asleep, never between.
+*/
+static void wakeOther(struct PPUThread *thread) {
+    pthread_mutex_lock(&thread->lock);
+    pthread_cond_broadcast(&thread->wake);
+    pthread_mutex_unlock(&thread->lock);
+}
+
+/*
+    Replays each log as it is handed over, copying out every frame that
+    gets finished. A chunk ending at vblank always finishes the frame.
+*/
+static void *run(void *context) {
+    struct PPUThread *thread = context;
+    struct PPU *renderer = thread->renderer;
+    unsigned chunk = 0;
+    for (;;) {
+        if (!waitFor(thread, &thread->submitted, chunk + 1)) {
+            return NULL;
+        }
+        ppu_renderChunk(renderer, &thread->logs[chunk & 1], thread->ends[chunk & 1]);
+        if (renderer->frameReady) {
+            unsigned frame = atomic_load_explicit(&thread->framesDone, memory_order_relaxed);
+            memcpy(thread->frames[frame & 1], renderer->frameBuffer, sizeof(thread->frames[0]));
+            memcpy(thread->emphasis[frame & 1], renderer->emphasis, sizeof(thread->emphasis[0]));
+            thread->skipped[frame & 1] = renderer->skipping;
+            renderer->frameReady = 0;
+            atomic_store_explicit(&thread->framesDone, frame + 1, memory_order_release);
+        }
+        chunk++;
+        atomic_store_explicit(&thread->consumed, chunk, memory_order_release);
+        wakeOther(thread);
+    }
+}
+
+int pputhread_start(struct PPUThread *thread, struct PPU *renderer) {
+    memset(thread, 0, sizeof(struct PPUThread));
+    thread->renderer = renderer;
+    ppulog_init(&thread->logs[0]);
+    ppulog_init(&thread->logs[1]);
+    atomic_init(&thread->submitted, 0);
+    atomic_init(&thread->consumed, 0);
+    atomic_init(&thread->framesDone, 0);
+    atomic_init(&thread->running, 1);
+    if (pthread_mutex_init(&thread->lock, NULL) != 0) {
+        return 0;
+    }
+    if (pthread_cond_init(&thread->wake, NULL) != 0) {
+        pthread_mutex_destroy(&thread->lock);
+        return 0;
+    }
+    if (pthread_create(&thread->thread, NULL, &run, thread) != 0) {
+        pthread_cond_destroy(&thread->wake);
+        pthread_mutex_destroy(&thread->lock);
+        return 0;
+    }
+    return 1;
+}
+
+void pputhread_stop(struct PPUThread *thread) {
+    atomic_store_explicit(&thread->running, 0, memory_order_relaxed);
+    wakeOther(thread);
+    pthread_join(thread->thread, NULL);
+    pthread_cond_destroy(&thread->wake);
+    pthread_mutex_destroy(&thread->lock);
+}
+
+/*
+    Hands the log being filled to the renderer, to be drawn up to end, and
+    returns the other one once the renderer has finished with it. The CPU
+    is never more than one log ahead.
+*/
+struct PPULog *pputhread_submit(struct PPUThread *thread, uint64_t end, int frameEnd) {
+    unsigned chunk = atomic_load_explicit(&thread->submitted, memory_order_relaxed);
+    thread->ends[chunk & 1] = end;
+    atomic_store_explicit(&thread->submitted, chunk + 1, memory_order_release);
+    wakeOther(thread);
+    thread->framesSubmitted += frameEnd;
+    waitFor(thread, &thread->consumed, chunk);
+    struct PPULog *log = &thread->logs[(chunk + 1) & 1];
+    ppulog_init(log);
+    return log;
+}
+
+/*
+    Gets the frame before the one the CPU has just finished, waiting for
+    the renderer if need be. Returns 0 if it was skipped or there isn't one
+    yet. The renderer can't start on the frame after next until the CPU
+    hands it over, so the copy stays put while it is presented.
+*/
+int pputhread_frame(struct PPUThread *thread, const uint8_t **pixels, const uint8_t **emphasis) {
+    *pixels = thread->frames[0];
+    *emphasis = thread->emphasis[0];
+    if (thread->framesSubmitted < 2) {
+        return 0;
+    }
+    unsigned frame = thread->framesSubmitted - 2;
+    waitFor(thread, &thread->framesDone, frame + 1);
+    *pixels = thread->frames[frame & 1];
+    *emphasis = thread->emphasis[frame & 1];
+    return !thread->skipped[frame & 1];
+}
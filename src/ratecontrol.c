@@ -0,0 +1,39 @@
+#include "./headers/ratecontrol.h"
+
+#define SMOOTHING 16
+#define INTEGRAL_GAIN 0.01
+
+
+void ratecontrol_init(struct RateControl *control, unsigned target) {
+    control->target = target;
+    control->average = target;
+    control->integral = 0;
+    control->ratio = 1.0;
+}
+
+/*
+    Takes the ring's fill after a frame's samples went in and returns what
+    to scale the sample rate by for the next frame. A ring filling up makes
+    fewer samples per frame, one draining makes more.
+*/
+double ratecontrol_update(struct RateControl *control, unsigned fill) {
+    control->average += (fill - control->average) / SMOOTHING;
+    double error = (control->target - control->average) / control->target;
+    double integral = control->integral + error * INTEGRAL_GAIN;
+    if (integral > 1.0) {
+        integral = 1.0;
+    }
+    else if (integral < -1.0) {
+        integral = -1.0;
+    }
+    control->integral = integral;
+    double ratio = 1.0 + RATE_MAX_DELTA * (error + integral);
+    if (ratio > 1.0 + RATE_MAX_DELTA) {
+        ratio = 1.0 + RATE_MAX_DELTA;
+    }
+    else if (ratio < 1.0 - RATE_MAX_DELTA) {
+        ratio = 1.0 - RATE_MAX_DELTA;
+    }
+    control->ratio = ratio;
+    return ratio;
+}
@@ -0,0 +1,281 @@
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "./headers/scale.h"
+
+
+/* --------------
+    Scalar Rows
+    ------------- */
+static void row16(uint16_t *out, const uint16_t *in, int width, int factor) {
+    for (int x = 0; x < width; x++) {
+        for (int i = 0; i < factor; i++) {
+            *out++ = in[x];
+        }
+    }
+}
+
+static void row32(uint32_t *out, const uint32_t *in, int width, int factor) {
+    for (int x = 0; x < width; x++) {
+        for (int i = 0; i < factor; i++) {
+            *out++ = in[x];
+        }
+    }
+}
+
+static void row16x2(uint8_t *dst, const uint8_t *src, int width) { row16((uint16_t *)dst, (const uint16_t *)src, width, 2); }
+static void row16x3(uint8_t *dst, const uint8_t *src, int width) { row16((uint16_t *)dst, (const uint16_t *)src, width, 3); }
+static void row16x4(uint8_t *dst, const uint8_t *src, int width) { row16((uint16_t *)dst, (const uint16_t *)src, width, 4); }
+static void row32x2(uint8_t *dst, const uint8_t *src, int width) { row32((uint32_t *)dst, (const uint32_t *)src, width, 2); }
+static void row32x3(uint8_t *dst, const uint8_t *src, int width) { row32((uint32_t *)dst, (const uint32_t *)src, width, 3); }
+static void row32x4(uint8_t *dst, const uint8_t *src, int width) { row32((uint32_t *)dst, (const uint32_t *)src, width, 4); }
+
+static void row24(uint8_t *out, const uint8_t *in, int width, int factor) {
+    for (int x = 0; x < width; x++) {
+        for (int i = 0; i < factor; i++) {
+            out[0] = in[0];
+            out[1] = in[1];
+            out[2] = in[2];
+            out += 3;
+        }
+        in += 3;
+    }
+}
+
+static void row24x2(uint8_t *dst, const uint8_t *src, int width) { row24(dst, src, width, 2); }
+static void row24x3(uint8_t *dst, const uint8_t *src, int width) { row24(dst, src, width, 3); }
+static void row24x4(uint8_t *dst, const uint8_t *src, int width) { row24(dst, src, width, 4); }
+
+
+/* --------------
+    Vector Rows
+    ------------- */
+
+/*
+    Each loads a vector of source pixels and stores factor vectors of
+    repeated pixels, any pixels past the last whole vector go through the
+    scalar row
+*/
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static void row32x2_sse2(uint8_t *dst, const uint8_t *src, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(src + x * 4));
+        _mm_storeu_si128((__m128i *)(dst + x * 8), _mm_unpacklo_epi32(in, in));
+        _mm_storeu_si128((__m128i *)(dst + x * 8 + 16), _mm_unpackhi_epi32(in, in));
+    }
+    row32((uint32_t *)dst + x * 2, (const uint32_t *)src + x, width - x, 2);
+}
+
+__attribute__((target("sse2")))
+static void row32x3_sse2(uint8_t *dst, const uint8_t *src, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(src + x * 4));
+        _mm_storeu_si128((__m128i *)(dst + x * 12), _mm_shuffle_epi32(in, _MM_SHUFFLE(1, 0, 0, 0)));
+        _mm_storeu_si128((__m128i *)(dst + x * 12 + 16), _mm_shuffle_epi32(in, _MM_SHUFFLE(2, 2, 1, 1)));
+        _mm_storeu_si128((__m128i *)(dst + x * 12 + 32), _mm_shuffle_epi32(in, _MM_SHUFFLE(3, 3, 3, 2)));
+    }
+    row32((uint32_t *)dst + x * 3, (const uint32_t *)src + x, width - x, 3);
+}
+
+__attribute__((target("sse2")))
+static void row32x4_sse2(uint8_t *dst, const uint8_t *src, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(src + x * 4));
+        _mm_storeu_si128((__m128i *)(dst + x * 16), _mm_shuffle_epi32(in, _MM_SHUFFLE(0, 0, 0, 0)));
+        _mm_storeu_si128((__m128i *)(dst + x * 16 + 16), _mm_shuffle_epi32(in, _MM_SHUFFLE(1, 1, 1, 1)));
+        _mm_storeu_si128((__m128i *)(dst + x * 16 + 32), _mm_shuffle_epi32(in, _MM_SHUFFLE(2, 2, 2, 2)));
+        _mm_storeu_si128((__m128i *)(dst + x * 16 + 48), _mm_shuffle_epi32(in, _MM_SHUFFLE(3, 3, 3, 3)));
+    }
+    row32((uint32_t *)dst + x * 4, (const uint32_t *)src + x, width - x, 4);
+}
+
+__attribute__((target("sse2")))
+static void row16x2_sse2(uint8_t *dst, const uint8_t *src, int width) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(src + x * 2));
+        _mm_storeu_si128((__m128i *)(dst + x * 4), _mm_unpacklo_epi16(in, in));
+        _mm_storeu_si128((__m128i *)(dst + x * 4 + 16), _mm_unpackhi_epi16(in, in));
+    }
+    row16((uint16_t *)dst + x * 2, (const uint16_t *)src + x, width - x, 2);
+}
+
+__attribute__((target("sse2")))
+static void row16x4_sse2(uint8_t *dst, const uint8_t *src, int width) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(src + x * 2));
+        __m128i low = _mm_unpacklo_epi16(in, in);
+        __m128i high = _mm_unpackhi_epi16(in, in);
+        _mm_storeu_si128((__m128i *)(dst + x * 8), _mm_unpacklo_epi32(low, low));
+        _mm_storeu_si128((__m128i *)(dst + x * 8 + 16), _mm_unpackhi_epi32(low, low));
+        _mm_storeu_si128((__m128i *)(dst + x * 8 + 32), _mm_unpacklo_epi32(high, high));
+        _mm_storeu_si128((__m128i *)(dst + x * 8 + 48), _mm_unpackhi_epi32(high, high));
+    }
+    row16((uint16_t *)dst + x * 4, (const uint16_t *)src + x, width - x, 4);
+}
+
+/*
+    Tripling 16 bit pixels needs a byte shuffle, 8 pixels make 24
+*/
+__attribute__((target("ssse3")))
+static void row16x3_ssse3(uint8_t *dst, const uint8_t *src, int width) {
+    const __m128i first = _mm_setr_epi8(0, 1, 0, 1, 0, 1, 2, 3, 2, 3, 2, 3, 4, 5, 4, 5);
+    const __m128i second = _mm_setr_epi8(4, 5, 6, 7, 6, 7, 6, 7, 8, 9, 8, 9, 8, 9, 10, 11);
+    const __m128i third = _mm_setr_epi8(10, 11, 10, 11, 12, 13, 12, 13, 12, 13, 14, 15, 14, 15, 14, 15);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(src + x * 2));
+        _mm_storeu_si128((__m128i *)(dst + x * 6), _mm_shuffle_epi8(in, first));
+        _mm_storeu_si128((__m128i *)(dst + x * 6 + 16), _mm_shuffle_epi8(in, second));
+        _mm_storeu_si128((__m128i *)(dst + x * 6 + 32), _mm_shuffle_epi8(in, third));
+    }
+    row16((uint16_t *)dst + x * 3, (const uint16_t *)src + x, width - x, 3);
+}
+#endif
+
+/*
+    The interleaving stores do the replication, storing the same vector
+    as every member of a vst2/vst3/vst4 group writes each lane 2, 3 or 4
+    times in a row
+*/
+#if defined(__aarch64__) || defined(__ARM_NEON)
+static void row32x2_neon(uint8_t *dst, const uint8_t *src, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        uint32x4_t in = vld1q_u32((const uint32_t *)(src + x * 4));
+        uint32x4x2_t out = { { in, in } };
+        vst2q_u32((uint32_t *)(dst + x * 8), out);
+    }
+    row32((uint32_t *)dst + x * 2, (const uint32_t *)src + x, width - x, 2);
+}
+
+static void row32x3_neon(uint8_t *dst, const uint8_t *src, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        uint32x4_t in = vld1q_u32((const uint32_t *)(src + x * 4));
+        uint32x4x3_t out = { { in, in, in } };
+        vst3q_u32((uint32_t *)(dst + x * 12), out);
+    }
+    row32((uint32_t *)dst + x * 3, (const uint32_t *)src + x, width - x, 3);
+}
+
+static void row32x4_neon(uint8_t *dst, const uint8_t *src, int width) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        uint32x4_t in = vld1q_u32((const uint32_t *)(src + x * 4));
+        uint32x4x4_t out = { { in, in, in, in } };
+        vst4q_u32((uint32_t *)(dst + x * 16), out);
+    }
+    row32((uint32_t *)dst + x * 4, (const uint32_t *)src + x, width - x, 4);
+}
+
+static void row16x2_neon(uint8_t *dst, const uint8_t *src, int width) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        uint16x8_t in = vld1q_u16((const uint16_t *)(src + x * 2));
+        uint16x8x2_t out = { { in, in } };
+        vst2q_u16((uint16_t *)(dst + x * 4), out);
+    }
+    row16((uint16_t *)dst + x * 2, (const uint16_t *)src + x, width - x, 2);
+}
+
+static void row16x3_neon(uint8_t *dst, const uint8_t *src, int width) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        uint16x8_t in = vld1q_u16((const uint16_t *)(src + x * 2));
+        uint16x8x3_t out = { { in, in, in } };
+        vst3q_u16((uint16_t *)(dst + x * 6), out);
+    }
+    row16((uint16_t *)dst + x * 3, (const uint16_t *)src + x, width - x, 3);
+}
+
+static void row16x4_neon(uint8_t *dst, const uint8_t *src, int width) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        uint16x8_t in = vld1q_u16((const uint16_t *)(src + x * 2));
+        uint16x8x4_t out = { { in, in, in, in } };
+        vst4q_u16((uint16_t *)(dst + x * 8), out);
+    }
+    row16((uint16_t *)dst + x * 4, (const uint16_t *)src + x, width - x, 4);
+}
+#endif
+
+
+/* --------
+    Set up
+    ------- */
+
+/*
+    Picks the row function for the format and factor, factors other than
+    2, 3 and 4 and pixel sizes other than 2, 3 and 4 bytes are refused
+*/
+int scale_init(struct Scaler *scaler, int bytesPerPixel, int factor) {
+    static void (*const scalar[3][3])(uint8_t *, const uint8_t *, int) = {
+        { &row16x2, &row16x3, &row16x4 },
+        { &row24x2, &row24x3, &row24x4 },
+        { &row32x2, &row32x3, &row32x4 }
+    };
+    if (bytesPerPixel < 2 || bytesPerPixel > 4 || factor < 2 || factor > 4) {
+        return 0;
+    }
+    scaler->bytesPerPixel = bytesPerPixel;
+    scaler->factor = factor;
+    scaler->name = "scalar";
+    scaler->row = scalar[bytesPerPixel - 2][factor - 2];
+#if defined(__x86_64__) || defined(__i386__)
+    static void (*const sse2[3][3])(uint8_t *, const uint8_t *, int) = {
+        { &row16x2_sse2, NULL, &row16x4_sse2 },
+        { NULL, NULL, NULL },
+        { &row32x2_sse2, &row32x3_sse2, &row32x4_sse2 }
+    };
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2") && sse2[bytesPerPixel - 2][factor - 2] != NULL) {
+        scaler->name = "sse2";
+        scaler->row = sse2[bytesPerPixel - 2][factor - 2];
+    }
+    if (__builtin_cpu_supports("ssse3") && bytesPerPixel == 2 && factor == 3) {
+        scaler->name = "ssse3";
+        scaler->row = &row16x3_ssse3;
+    }
+#endif
+#if defined(__aarch64__) || defined(__ARM_NEON)
+    static void (*const neon[3][3])(uint8_t *, const uint8_t *, int) = {
+        { &row16x2_neon, &row16x3_neon, &row16x4_neon },
+        { NULL, NULL, NULL },
+        { &row32x2_neon, &row32x3_neon, &row32x4_neon }
+    };
+    if (neon[bytesPerPixel - 2][factor - 2] != NULL) {
+        scaler->name = "neon";
+        scaler->row = neon[bytesPerPixel - 2][factor - 2];
+    }
+#endif
+    return 1;
+}
+
+
+/* ---------
+    Scaling
+    -------- */
+
+/*
+    Fills the factor - 1 lines below an already scaled line with copies of
+    it
+*/
+void scale_duplicate(const struct Scaler *scaler, uint8_t *dst, int dstPitch, int width) {
+    int bytes = width * scaler->factor * scaler->bytesPerPixel;
+    for (int i = 1; i < scaler->factor; i++) {
+        memcpy(dst + i * dstPitch, dst, bytes);
+    }
+}
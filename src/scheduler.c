@@ -0,0 +1,75 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./headers/scheduler.h"
+
+
+static void findNext(struct Scheduler *scheduler) {
+    scheduler->next = SCHEDULER_NEVER;
+    for (int event = 0; event < EVENT_COUNT; event++) {
+        if (scheduler->deadline[event] < scheduler->next) {
+            scheduler->next = scheduler->deadline[event];
+        }
+    }
+}
+
+void scheduler_init(struct Scheduler *scheduler) {
+    scheduler->now = 0;
+    for (int event = 0; event < EVENT_COUNT; event++) {
+        scheduler->deadline[event] = SCHEDULER_NEVER;
+        scheduler->handlers[event] = NULL;
+        scheduler->contexts[event] = NULL;
+    }
+    scheduler->next = SCHEDULER_NEVER;
+}
+
+void scheduler_setHandler(struct Scheduler *scheduler, enum Event event, void (*handler)(void *context, enum Event event), void *context) {
+    scheduler->handlers[event] = handler;
+    scheduler->contexts[event] = context;
+}
+
+void scheduler_schedule(struct Scheduler *scheduler, enum Event event, uint64_t time) {
+    scheduler->deadline[event] = time;
+    if (time < scheduler->next) {
+        scheduler->next = time;
+    }
+    else {
+        findNext(scheduler);
+    }
+}
+
+void scheduler_cancel(struct Scheduler *scheduler, enum Event event) {
+    scheduler->deadline[event] = SCHEDULER_NEVER;
+    findNext(scheduler);
+}
+
+/*
+    Removes and returns the earliest event that is due, or -1 if none are
+*/
+int scheduler_pop(struct Scheduler *scheduler) {
+    if (scheduler->next > scheduler->now) {
+        return -1;
+    }
+    int earliest = 0;
+    for (int event = 1; event < EVENT_COUNT; event++) {
+        if (scheduler->deadline[event] < scheduler->deadline[earliest]) {
+            earliest = event;
+        }
+    }
+    scheduler->deadline[earliest] = SCHEDULER_NEVER;
+    findNext(scheduler);
+    return earliest;
+}
+
+/*
+    Dispatches every event that is due, in time order. Safe to call from
+    inside a register access, handlers may schedule further events.
+*/
+void scheduler_run(struct Scheduler *scheduler) {
+    int event;
+    while ((event = scheduler_pop(scheduler)) >= 0) {
+        if (scheduler->handlers[event] != NULL) {
+            scheduler->handlers[event](scheduler->contexts[event], event);
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "./headers/sprites.h"
+
+
+/*
+    Buckets all 64 sprites by the lines they cover. A sprite with Y = y is
+    evaluated on line y and drawn on lines y + 1 to y + height.
+*/
+void sprites_build(struct SpriteLists *lists, const uint8_t *oam, int height) {
+    memset(lists->count, 0, sizeof(lists->count));
+    memset(lists->overflow, 0, sizeof(lists->overflow));
+
+    for (int sprite = 0; sprite < 64; sprite++) {
+        int top = oam[sprite * 4] + 1;
+        int bottom = top + height;
+        if (bottom > SPRITE_LINES) {
+            bottom = SPRITE_LINES;
+        }
+        for (int line = top; line < bottom; line++) {
+            if (lists->count[line] < SPRITES_PER_LINE) {
+                lists->sprites[line][lists->count[line]++] = sprite;
+            }
+            else {
+                lists->overflow[line] = 1;
+            }
+        }
+    }
+    lists->height = height;
+    lists->dirty = 0;
+}
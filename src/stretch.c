@@ -0,0 +1,160 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "./headers/stretch.h"
+
+#define COARSE_STEP 4
+
+
+/* ---------
+    Set up
+    -------- */
+
+/*
+    Sequences of 20ms joined over 8ms, each free to start anywhere in the
+    12ms after where it nominally would. Short enough that notes and
+    drums stay sharp, long enough to hold a period of the lowest bass.
+*/
+void stretch_init(struct Stretch *stretch, int sampleRate) {
+    memset(stretch, 0, sizeof(struct Stretch));
+    if (sampleRate > STRETCH_MAX_RATE) {
+        sampleRate = STRETCH_MAX_RATE;
+    }
+    stretch->sequence = sampleRate / 50;
+    stretch->overlap = sampleRate / 125;
+    stretch->seek = sampleRate * 12 / 1000;
+    stretch->speed = 1.0;
+}
+
+void stretch_setSpeed(struct Stretch *stretch, double speed) {
+    if (speed < STRETCH_MIN_SPEED) {
+        speed = STRETCH_MIN_SPEED;
+    }
+    else if (speed > STRETCH_MAX_SPEED) {
+        speed = STRETCH_MAX_SPEED;
+    }
+    stretch->speed = speed;
+}
+
+
+/* ---------
+    Matching
+    -------- */
+
+/*
+    How alike the tail and the input at candidate are, normalised by the
+    candidate's energy so loud stretches don't always win. Only every
+    other sample is looked at, which is plenty at these lengths.
+*/
+static double similarity(const struct Stretch *stretch, int candidate) {
+    const int16_t *input = stretch->input + candidate;
+    int64_t product = 0;
+    int64_t energy = 0;
+    for (int i = 0; i < stretch->overlap; i += 2) {
+        product += (int32_t)stretch->tail[i] * input[i];
+        energy += (int32_t)input[i] * input[i];
+    }
+    return (double)product / sqrt((double)energy + 1.0);
+}
+
+/*
+    Searches the window every few samples, then around the best of those
+    sample by sample
+*/
+static int bestOffset(const struct Stretch *stretch) {
+    int best = 0;
+    double bestScore = -INFINITY;
+    for (int offset = 0; offset < stretch->seek; offset += COARSE_STEP) {
+        double score = similarity(stretch, offset);
+        if (score > bestScore) {
+            bestScore = score;
+            best = offset;
+        }
+    }
+    int coarse = best;
+    for (int offset = coarse - COARSE_STEP + 1; offset < coarse + COARSE_STEP; offset++) {
+        if (offset < 0 || offset >= stretch->seek || offset == coarse) {
+            continue;
+        }
+        double score = similarity(stretch, offset);
+        if (score > bestScore) {
+            bestScore = score;
+            best = offset;
+        }
+    }
+    return best;
+}
+
+
+/* -----------
+    Processing
+    ---------- */
+
+/*
+    Writes one sequence from offset, less its last overlap which is kept
+    to crossfade into the next, and returns how many samples that was
+*/
+static int emitSequence(struct Stretch *stretch, int offset, int16_t *out) {
+    const int16_t *input = stretch->input + offset;
+    int overlap = stretch->overlap;
+    int length = stretch->sequence - overlap;
+    for (int i = 0; i < overlap; i++) {
+        out[i] = stretch->haveTail ? (int16_t)((stretch->tail[i] * (overlap - i) + input[i] * i) / overlap) : input[i];
+    }
+    memcpy(out + overlap, input + overlap, (length - overlap) * sizeof(int16_t));
+    memcpy(stretch->tail, input + length, overlap * sizeof(int16_t));
+    stretch->haveTail = 1;
+    return length;
+}
+
+/*
+    Drops the input the last sequence moved past. At high speeds that can
+    be more than has come in yet, and the rest goes as soon as it arrives.
+*/
+static void skipInput(struct Stretch *stretch) {
+    int count = (int)stretch->skip;
+    if (count > stretch->inputCount) {
+        count = stretch->inputCount;
+    }
+    stretch->skip -= count;
+    stretch->inputCount -= count;
+    memmove(stretch->input, stretch->input + count, stretch->inputCount * sizeof(int16_t));
+}
+
+/*
+    Takes count samples in and returns how many came out, at most room.
+    At normal speed samples pass straight through, after any still held
+    from stretching. Input that doesn't fit is dropped, which only happens
+    if out is far too small.
+*/
+int stretch_process(struct Stretch *stretch, const int16_t *in, int count, int16_t *out, int room) {
+    int produced = 0;
+    if (stretch->speed == 1.0) {
+        produced = (stretch->inputCount < room) ? stretch->inputCount : room;
+        memcpy(out, stretch->input, produced * sizeof(int16_t));
+        stretch->skip = produced;
+        skipInput(stretch);
+        int direct = (count < room - produced) ? count : room - produced;
+        memcpy(out + produced, in, direct * sizeof(int16_t));
+        stretch->haveTail = 0;
+        return produced + direct;
+    }
+
+    int space = STRETCH_INPUT - stretch->inputCount;
+    if (count > space) {
+        count = space;
+    }
+    memcpy(stretch->input + stretch->inputCount, in, count * sizeof(int16_t));
+    stretch->inputCount += count;
+
+    int length = stretch->sequence - stretch->overlap;
+    skipInput(stretch);
+    while (stretch->skip < 1.0 && stretch->inputCount >= stretch->seek + stretch->sequence && produced + length <= room) {
+        int offset = stretch->haveTail ? bestOffset(stretch) : 0;
+        produced += emitSequence(stretch, offset, out + produced);
+        stretch->skip += stretch->speed * length;
+        skipInput(stretch);
+    }
+    return produced;
+}
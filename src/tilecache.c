@@ -0,0 +1,95 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "./headers/tilecache.h"
+
+
+/*
+    spread[b] places bit 7 of b in byte 0, bit 6 in byte 1 and so on, which
+    turns one bitplane row into eight 0/1 pixels
+*/
+static uint64_t spread[256];
+static int spreadReady = 0;
+
+static void buildSpreadTable() {
+    for (int b = 0; b < 256; b++) {
+        uint64_t row = 0;
+        for (int pixel = 0; pixel < 8; pixel++) {
+            if (b & (0x80 >> pixel)) {
+                row |= (uint64_t)1 << (pixel * 8);
+            }
+        }
+        spread[b] = row;
+    }
+    spreadReady = 1;
+}
+
+static void decodeTile(struct TileCache *cache, uint32_t tile) {
+    const uint8_t *planes = cache->chr + tile * TILE_BYTES;
+    uint64_t *rows = cache->rows + tile * TILE_ROWS;
+    for (int row = 0; row < TILE_ROWS; row++) {
+        rows[row] = spread[planes[row]] | (spread[planes[row + 8]] << 1);
+    }
+}
+
+
+/*
+    Decodes every tile in chr up front, for CHR-ROM this is the only decode
+    that ever happens and bank switches just move pointers into rows
+*/
+int tilecache_init(struct TileCache *cache, const uint8_t *chr, uint32_t size) {
+    if (!spreadReady) {
+        buildSpreadTable();
+    }
+    cache->chr = chr;
+    cache->tileCount = size / TILE_BYTES;
+    cache->rows = malloc(sizeof(uint64_t) * TILE_ROWS * cache->tileCount);
+    cache->dirty = calloc((cache->tileCount + 31) / 32, sizeof(uint32_t));
+    cache->dirtyCount = 0;
+    if (cache->rows == NULL || cache->dirty == NULL) {
+        tilecache_free(cache);
+        return 0;
+    }
+    for (uint32_t tile = 0; tile < cache->tileCount; tile++) {
+        decodeTile(cache, tile);
+    }
+    return 1;
+}
+
+void tilecache_free(struct TileCache *cache) {
+    free(cache->rows);
+    free(cache->dirty);
+    cache->rows = NULL;
+    cache->dirty = NULL;
+    cache->tileCount = 0;
+    cache->dirtyCount = 0;
+}
+
+/*
+    Called for every CHR-RAM write, address is the offset into chr
+*/
+void tilecache_markDirty(struct TileCache *cache, uint32_t address) {
+    uint32_t tile = address / TILE_BYTES;
+    uint32_t bit = (uint32_t)1 << (tile & 31);
+    if (!(cache->dirty[tile >> 5] & bit)) {
+        cache->dirty[tile >> 5] |= bit;
+        cache->dirtyCount++;
+    }
+}
+
+/*
+    Redecodes the tiles written since the last flush
+*/
+void tilecache_flush(struct TileCache *cache) {
+    uint32_t words = (cache->tileCount + 31) / 32;
+    for (uint32_t word = 0; word < words && cache->dirtyCount; word++) {
+        uint32_t bits = cache->dirty[word];
+        cache->dirty[word] = 0;
+        while (bits) {
+            int bit = __builtin_ctz(bits);
+            bits &= bits - 1;
+            decodeTile(cache, word * 32 + bit);
+            cache->dirtyCount--;
+        }
+    }
+}